@@ -171,6 +171,10 @@ ifeq ($(strip $(UNICODE_ENABLE)), yes)
 	SRC += $(QUANTUM_DIR)/process_keycode/process_unicode.c
 endif
 
+ifeq ($(strip $(UNICODE_ASYNC_ENABLE)), yes)
+	OPT_DEFS += -DUNICODE_ASYNC_ENABLE
+endif
+
 ifeq ($(strip $(RGBLIGHT_ENABLE)), yes)
 	OPT_DEFS += -DRGBLIGHT_ENABLE
 	SRC += $(QUANTUM_DIR)/light_ws2812.c
@@ -180,6 +184,43 @@ endif
 ifeq ($(strip $(TAP_DANCE_ENABLE)), yes)
 	OPT_DEFS += -DTAP_DANCE_ENABLE
 	SRC += $(QUANTUM_DIR)/process_keycode/process_tap_dance.c
+	TAP_HOLD_ENABLE = yes
+endif
+
+# Space cadet shift is on unless SPACE_CADET_ENABLE = no
+ifneq ($(strip $(SPACE_CADET_ENABLE)), no)
+	OPT_DEFS += -DSPACE_CADET_ENABLE
+	TAP_HOLD_ENABLE = yes
+endif
+
+ifeq ($(strip $(TAP_HOLD_ENABLE)), yes)
+	OPT_DEFS += -DTAP_HOLD_ENABLE
+	SRC += $(QUANTUM_DIR)/tap_hold.c
+endif
+
+ifeq ($(strip $(COMBO_ENABLE)), yes)
+	OPT_DEFS += -DCOMBO_ENABLE
+	SRC += $(QUANTUM_DIR)/process_keycode/process_combo.c
+endif
+
+ifeq ($(strip $(SEND_STRING_ASYNC_ENABLE)), yes)
+	OPT_DEFS += -DSEND_STRING_ASYNC_ENABLE
+	SRC += $(QUANTUM_DIR)/send_string.c
+endif
+
+ifeq ($(strip $(SPARSE_KEYMAP_ENABLE)), yes)
+	OPT_DEFS += -DSPARSE_KEYMAP_ENABLE
+	SRC += $(KEYMAP_OUTPUT)/keymap_sparse.c
+endif
+
+ifeq ($(strip $(LEADER_TRIE_ENABLE)), yes)
+	OPT_DEFS += -DLEADER_TRIE_ENABLE
+	SRC += $(KEYMAP_OUTPUT)/leader_trie.c
+endif
+
+ifeq ($(strip $(DYNAMIC_KEYMAP_ENABLE)), yes)
+	OPT_DEFS += -DDYNAMIC_KEYMAP_ENABLE
+	SRC += $(QUANTUM_DIR)/dynamic_keymap.c
 endif
 
 ifeq ($(strip $(PRINTING_ENABLE)), yes)
@@ -252,3 +293,29 @@ build: elf hex
 
 include $(TMK_PATH)/rules.mk
 
+ifeq ($(strip $(SPARSE_KEYMAP_ENABLE)), yes)
+# The dense keymaps[] is read back out of the compiled keymap and re-encoded.
+# Nothing references it afterwards, so --gc-sections drops it from the image.
+SPARSE_KEYMAP_OBJ := $(patsubst %.c,$(KEYMAP_OUTPUT)/%.o,$(KEYMAP_C))
+
+$(KEYMAP_OUTPUT)/keymap_sparse.c: $(SPARSE_KEYMAP_OBJ) util/sparse_keymap.sh
+	$(OBJCOPY) -O binary -j .progmem.data.keymaps -j .rodata.keymaps $< $@.bin
+	echo "MATRIX_ROWS MATRIX_COLS" | $(CC) -E -P $($(KEYMAP_OUTPUT)_CFLAGS) -x c - | tail -n 1 > $@.shape
+	sh util/sparse_keymap.sh $@.bin `cat $@.shape` $(TARGET) > $@
+endif
+
+ifeq ($(strip $(LEADER_TRIE_ENABLE)), yes)
+# The keys of leader_sequences[] are read back out of the compiled keymap and
+# turned into a trie. The table stays, the trie refers to its functions.
+# Whichever keymap object defines it, the others add nothing to the .bin.
+LEADER_TRIE_OBJ := $(patsubst %.c,$(KEYMAP_OUTPUT)/%.o,$(KEYMAP_C))
+
+$(KEYMAP_OUTPUT)/leader_trie.c: $(LEADER_TRIE_OBJ) util/leader_trie.sh
+	rm -f $@.bin
+	for obj in $(LEADER_TRIE_OBJ); do \
+		$(OBJCOPY) -O binary -j .progmem.data.leader_sequences -j .rodata.leader_sequences $$obj $@.part && \
+		cat $@.part >> $@.bin || exit 1; \
+	done
+	printf '#include "process_leader.h"\nLEADER_SEQUENCE_COUNT LEADER_MAX_LENGTH\n' | $(CC) -E -P $($(KEYMAP_OUTPUT)_CFLAGS) -x c - | tail -n 1 > $@.shape
+	sh util/leader_trie.sh $@.bin `cat $@.shape` $(TARGET) > $@
+endif
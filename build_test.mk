@@ -43,6 +43,9 @@ VPATH += $(COMMON_VPATH)
 
 include $(TMK_PATH)/common.mk
 include $(QUANTUM_PATH)/serial_link/tests/rules.mk
+include $(TMK_PATH)/common/tests/rules.mk
+include $(QUANTUM_PATH)/process_keycode/tests/rules.mk
+include $(TMK_PATH)/protocol/usb_hid/tests/rules.mk
 
 $(TEST_OBJ)/$(TEST)_SRC := $($(TEST)_SRC)
 $(TEST_OBJ)/$(TEST)_INC := $($(TEST)_INC) $(VPATH) $(GTEST_INC)
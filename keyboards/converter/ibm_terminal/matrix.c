@@ -23,6 +23,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "util.h"
 #include "debug.h"
 #include "ps2.h"
+#include "scan_decoder.h"
 #include "matrix.h"
 
 #define print_matrix_row(row)  print_bin_reverse8(matrix_get_row(row))
@@ -33,6 +34,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 static void matrix_make(uint8_t code);
 static void matrix_break(uint8_t code);
+static void matrix_event(scan_event_t event);
+
+static scan_decoder_t decoder;
 
 
 /*
@@ -83,9 +87,14 @@ uint8_t matrix_scan(void)
         KBD_ID1,
         CONFIG,
         READY,
-        F0,
     } state = RESET;
 
+    // all that came in since the last scan
+    if (state == READY) {
+        scan_decoder_task(&decoder, ps2_host_recv, matrix_event);
+        return 1;
+    }
+
     uint8_t code;
     if ((code = ps2_host_recv())) {
         debug("r"); debug_hex(code); debug(" ");
@@ -124,45 +133,28 @@ uint8_t matrix_scan(void)
             debug("wF8 ");
             if (ps2_host_send(0xF8) == 0xFA) {
                 debug("[ack]\nREADY\n");
+                scan_decoder_init(&decoder, scan_set3, SCAN_SET3_SIZE);
                 state = READY;
             }
             break;
         case READY:
-            switch (code) {
-                case 0x00:
-                    break;
-                case 0xF0:
-                    state = F0;
-                    debug(" ");
-                    break;
-                default:    // normal key make
-                    if (code < 0x88) {
-                        matrix_make(code);
-                    } else {
-                        debug("unexpected scan code at READY: "); debug_hex(code); debug("\n");
-                    }
-                    state = READY;
-                    debug("\n");
-            }
-            break;
-        case F0:    // Break code
-            switch (code) {
-                case 0x00:
-                    break;
-                default:
-                    if (code < 0x88) {
-                        matrix_break(code);
-                    } else {
-                        debug("unexpected scan code at F0: "); debug_hex(code); debug("\n");
-                    }
-                    state = READY;
-                    debug("\n");
-            }
             break;
     }
     return 1;
 }
 
+static void matrix_event(scan_event_t event)
+{
+    debug((event.state & SCAN_BREAK) ? "rF0 " : "r"); debug_hex(event.code); debug("\n");
+    if (SCAN_PAGE(event.state) || event.code >= 0x88) {
+        debug("unexpected scan code: "); debug_hex(event.code); debug("\n");
+    } else if (event.state & SCAN_BREAK) {
+        matrix_break(event.code);
+    } else {
+        matrix_make(event.code);
+    }
+}
+
 inline
 uint8_t matrix_get_row(uint8_t row)
 {
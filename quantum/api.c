@@ -45,7 +45,8 @@ void process_api(uint16_t length, uint8_t * data) {
                     break;
                 }
                 case DT_KEYMAP_OPTIONS: {
-                    eeconfig_update_keymap(data[2]);
+                    keymap_config.raw = data[2];
+                    eeconfig_update_keymap(keymap_config.raw);
                     break;
                 }
                 case DT_RGBLIGHT: {
@@ -74,7 +75,7 @@ void process_api(uint16_t length, uint8_t * data) {
                 }
                 case DT_CURRENT_LAYER: {
                     uint8_t layer_state_bytes[4];
-                    dword_to_bytes(layer_state, layer_state_bytes);
+                    dword_to_bytes((uint32_t)layer_state, layer_state_bytes);
                     MT_GET_DATA_ACK(DT_CURRENT_LAYER, layer_state_bytes, 4);
                     break;
                 }
@@ -116,29 +117,16 @@ void process_api(uint16_t length, uint8_t * data) {
                     MT_GET_DATA_ACK(DT_KEYMAP_SIZE, keymap_size, 2);
                     break;
                 }
-                // This may be too much
-                // case DT_KEYMAP: {
-                //     uint8_t keymap_data[MATRIX_ROWS * MATRIX_COLS * 4 + 3];
-                //     keymap_data[0] = data[2];
-                //     keymap_data[1] = MATRIX_ROWS;
-                //     keymap_data[2] = MATRIX_COLS;
-                //     for (int i = 0; i < MATRIX_ROWS; i++) {
-                //         for (int j = 0; j < MATRIX_COLS; j++) {
-                //             keymap_data[3 + (i*MATRIX_COLS*2) + (j*2)] = pgm_read_word(&keymaps[data[2]][i][j]) >> 8;
-                //             keymap_data[3 + (i*MATRIX_COLS*2) + (j*2) + 1] = pgm_read_word(&keymaps[data[2]][i][j]) & 0xFF;
-                //         }
-                //     }
-                //     MT_GET_DATA_ACK(DT_KEYMAP, keymap_data, MATRIX_ROWS * MATRIX_COLS * 4 + 3);
-                //     // uint8_t keymap_data[5];
-                //     // keymap_data[0] = data[2];
-                //     // keymap_data[1] = data[3];
-                //     // keymap_data[2] = data[4];
-                //     // keymap_data[3] = pgm_read_word(&keymaps[data[2]][data[3]][data[4]]) >> 8;
-                //     // keymap_data[4] = pgm_read_word(&keymaps[data[2]][data[3]][data[4]]) & 0xFF;
-
-                //     // MT_GET_DATA_ACK(DT_KEYMAP, keymap_data, 5);
-                //     break;
-                // }
+                #ifdef DYNAMIC_KEYMAP_ENABLE
+                case DT_KEYMAP: {
+                    uint8_t response[32];
+                    uint8_t response_length = 0;
+                    if (length > 2)
+                        response_length = dynamic_keymap_command(data + 2, length - 2, response, sizeof(response));
+                    MT_GET_DATA_ACK(DT_KEYMAP, response, response_length);
+                    break;
+                }
+                #endif
                 default:
                     break;
             }
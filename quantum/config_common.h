@@ -64,6 +64,9 @@
 #      define SERIAL_UART_UBRR (F_CPU / (16UL * SERIAL_UART_BAUD) - 1)
 #      define SERIAL_UART_RXD_VECT USART1_RX_vect
 #      define SERIAL_UART_TXD_READY (UCSR1A & _BV(UDRE1))
+#      define SERIAL_UART_TXD_VECT USART1_UDRE_vect
+#      define SERIAL_UART_TXD_INT_ON()  (UCSR1B |= _BV(UDRIE1))
+#      define SERIAL_UART_TXD_INT_OFF() (UCSR1B &= ~_BV(UDRIE1))
 #      define SERIAL_UART_INIT() do { \
             /* baud rate */ \
             UBRR1L = SERIAL_UART_UBRR; \
@@ -0,0 +1,231 @@
+#include "dynamic_keymap.h"
+#include "eeprom.h"
+#ifdef RAW_ENABLE
+  #include "raw_hid.h"
+#endif
+
+// EEPROM layout: magic, CRC of the keymap bytes, keymap bytes
+#define EE_MAGIC ((uint8_t *)DYNAMIC_KEYMAP_EEPROM_ADDR)
+#define EE_CRC   ((uint8_t *)(DYNAMIC_KEYMAP_EEPROM_ADDR + 2))
+#define EE_DATA  ((uint8_t *)(DYNAMIC_KEYMAP_EEPROM_ADDR + 4))
+// Changed along with DYNAMIC_KEYMAP_FLASH
+#define DYNAMIC_KEYMAP_MAGIC 0x4B4E
+
+#if defined(E2END) && DYNAMIC_KEYMAP_EEPROM_END > E2END + 1
+  #error "Dynamic keymap doesn't fit in EEPROM, lower DYNAMIC_KEYMAP_LAYER_COUNT"
+#endif
+
+static bool committed = false;
+static bool transaction = false;
+
+#if DYNAMIC_KEYMAP_CACHE_LAYERS > 0
+#define CACHE_EMPTY 0xFF
+
+static uint16_t cache[DYNAMIC_KEYMAP_CACHE_LAYERS][MATRIX_ROWS][MATRIX_COLS];
+static uint8_t cache_layer[DYNAMIC_KEYMAP_CACHE_LAYERS];
+static layer_state_t cache_state;
+static bool cache_valid = false;
+#endif
+
+static uint16_t read_word(const uint8_t *addr) {
+  return (uint16_t)eeprom_read_byte(addr) << 8 | eeprom_read_byte(addr + 1);
+}
+
+static void write_word(uint8_t *addr, uint16_t value) {
+  eeprom_update_byte(addr, value >> 8);
+  eeprom_update_byte(addr + 1, value & 0xFF);
+}
+
+// CRC-16/CCITT, as sent by the host with COMMIT
+static uint16_t keymap_crc(void) {
+  uint16_t crc = 0xFFFF;
+  for (uint16_t i = 0; i < DYNAMIC_KEYMAP_SIZE; i++) {
+    crc ^= (uint16_t)eeprom_read_byte(EE_DATA + i) << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+static void cache_invalidate(void) {
+#if DYNAMIC_KEYMAP_CACHE_LAYERS > 0
+  for (uint8_t slot = 0; slot < DYNAMIC_KEYMAP_CACHE_LAYERS; slot++) {
+    cache_layer[slot] = CACHE_EMPTY;
+  }
+  cache_valid = false;
+#endif
+}
+
+void dynamic_keymap_init(void) {
+  committed = read_word(EE_MAGIC) == DYNAMIC_KEYMAP_MAGIC &&
+              read_word(EE_CRC) == keymap_crc();
+  cache_invalidate();
+}
+
+#if DYNAMIC_KEYMAP_CACHE_LAYERS > 0
+static void cache_load(uint8_t slot, uint8_t layer) {
+  const uint8_t *addr = EE_DATA + (uint16_t)layer * MATRIX_ROWS * MATRIX_COLS * 2;
+  for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+    for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+      cache[slot][row][col] = read_word(addr);
+      addr += 2;
+    }
+  }
+  cache_layer[slot] = layer;
+}
+
+// Mirror the highest active layers, keeping the ones already loaded
+static void cache_update(layer_state_t state) {
+  uint8_t wanted[DYNAMIC_KEYMAP_CACHE_LAYERS];
+  uint8_t count = 0;
+  bool keep[DYNAMIC_KEYMAP_CACHE_LAYERS] = {0};
+
+  while (state && count < DYNAMIC_KEYMAP_CACHE_LAYERS) {
+    uint8_t layer = highest_layer(state);
+    state &= ~LAYER_BIT(layer);
+    if (layer < DYNAMIC_KEYMAP_LAYER_COUNT)
+      wanted[count++] = layer;
+  }
+
+  for (uint8_t i = 0; i < count; i++) {
+    for (uint8_t slot = 0; slot < DYNAMIC_KEYMAP_CACHE_LAYERS; slot++) {
+      if (cache_layer[slot] == wanted[i]) {
+        keep[slot] = true;
+        wanted[i] = CACHE_EMPTY;
+        break;
+      }
+    }
+  }
+  for (uint8_t i = 0, slot = 0; i < count; i++) {
+    if (wanted[i] == CACHE_EMPTY)
+      continue;
+    while (keep[slot])
+      slot++;
+    cache_load(slot, wanted[i]);
+    keep[slot] = true;
+  }
+  for (uint8_t slot = 0; slot < DYNAMIC_KEYMAP_CACHE_LAYERS; slot++) {
+    if (!keep[slot])
+      cache_layer[slot] = CACHE_EMPTY;
+  }
+}
+#endif
+
+uint16_t dynamic_keymap_get_keycode(uint8_t layer, uint8_t row, uint8_t col) {
+  if (!committed || layer >= DYNAMIC_KEYMAP_LAYER_COUNT)
+    return DYNAMIC_KEYMAP_FLASH;
+
+#if DYNAMIC_KEYMAP_CACHE_LAYERS > 0
+  // layer 0 is the fallback when nothing else is on
+  layer_state_t state = layer_state | default_layer_state | 1;
+  if (!cache_valid || state != cache_state) {
+    cache_update(state);
+    cache_state = state;
+    cache_valid = true;
+  }
+  for (uint8_t slot = 0; slot < DYNAMIC_KEYMAP_CACHE_LAYERS; slot++) {
+    if (cache_layer[slot] == layer)
+      return cache[slot][row][col];
+  }
+#endif
+  return read_word(EE_DATA + (((uint16_t)layer * MATRIX_ROWS + row) * MATRIX_COLS + col) * 2);
+}
+
+static void keymap_invalidate(void) {
+  committed = false;
+  eeprom_update_byte(EE_MAGIC, 0);
+  cache_invalidate();
+}
+
+uint8_t dynamic_keymap_command(const uint8_t *request, uint8_t length, uint8_t *response, uint8_t size) {
+  if (length < 1 || size < 2)
+    return 0;
+
+  uint8_t status = DYNAMIC_KEYMAP_OK;
+  uint8_t response_length = 2;
+  uint16_t offset = length >= 3 ? (uint16_t)request[1] << 8 | request[2] : 0;
+  uint8_t count = length >= 4 ? request[3] : 0;
+
+  response[0] = request[0];
+  switch (request[0]) {
+    case DYNAMIC_KEYMAP_GET_INFO:
+      if (size < 6) {
+        status = DYNAMIC_KEYMAP_BAD_RANGE;
+        break;
+      }
+      response[2] = DYNAMIC_KEYMAP_LAYER_COUNT;
+      response[3] = MATRIX_ROWS;
+      response[4] = MATRIX_COLS;
+      response[5] = committed;
+      response_length = 6;
+      break;
+    case DYNAMIC_KEYMAP_READ:
+      if (length < 4 || size < 5 || count > size - 5 || offset + count > DYNAMIC_KEYMAP_SIZE) {
+        status = DYNAMIC_KEYMAP_BAD_RANGE;
+        break;
+      }
+      response[2] = request[1];
+      response[3] = request[2];
+      response[4] = count;
+      for (uint8_t i = 0; i < count; i++) {
+        response[5 + i] = eeprom_read_byte(EE_DATA + offset + i);
+      }
+      response_length = 5 + count;
+      break;
+    case DYNAMIC_KEYMAP_BEGIN:
+      // from here on the flash keymap is used until COMMIT
+      keymap_invalidate();
+      transaction = true;
+      break;
+    case DYNAMIC_KEYMAP_WRITE:
+      if (!transaction) {
+        status = DYNAMIC_KEYMAP_NO_TRANSACTION;
+      } else if (length < 4 || count > length - 4 || offset + count > DYNAMIC_KEYMAP_SIZE) {
+        status = DYNAMIC_KEYMAP_BAD_RANGE;
+      } else {
+        for (uint8_t i = 0; i < count; i++) {
+          eeprom_update_byte(EE_DATA + offset + i, request[4 + i]);
+        }
+      }
+      break;
+    case DYNAMIC_KEYMAP_COMMIT: {
+      if (!transaction) {
+        status = DYNAMIC_KEYMAP_NO_TRANSACTION;
+        break;
+      }
+      uint16_t crc = keymap_crc();
+      if (length < 3 || crc != offset) {
+        // stays open, the host can resend what got lost
+        status = DYNAMIC_KEYMAP_BAD_CHECKSUM;
+        break;
+      }
+      write_word(EE_CRC, crc);
+      write_word(EE_MAGIC, DYNAMIC_KEYMAP_MAGIC);
+      transaction = false;
+      committed = true;
+      cache_invalidate();
+      break;
+    }
+    case DYNAMIC_KEYMAP_RESET:
+      keymap_invalidate();
+      transaction = false;
+      break;
+    default:
+      status = DYNAMIC_KEYMAP_UNKNOWN;
+      break;
+  }
+  response[1] = status;
+  return response_length;
+}
+
+#ifdef RAW_ENABLE
+__attribute__ ((weak))
+void dynamic_keymap_raw_hid_receive(uint8_t *data, uint8_t length) {
+  uint8_t response[32] = {0};
+  if (length > sizeof(response))
+    length = sizeof(response);
+  dynamic_keymap_command(data, length, response, length);
+  raw_hid_send(response, length);
+}
+#endif
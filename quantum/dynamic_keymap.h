@@ -0,0 +1,89 @@
+#ifndef DYNAMIC_KEYMAP_H
+#define DYNAMIC_KEYMAP_H
+
+#include "quantum.h"
+
+/* Dynamic keymap
+ *
+ * The first DYNAMIC_KEYMAP_LAYER_COUNT layers can be remapped at runtime.
+ * Their keycodes live in EEPROM and override the flash keymap; an entry of
+ * DYNAMIC_KEYMAP_FLASH falls through to the flash keymap. It sits in the
+ * unassigned range between one shot mods and mod taps, so every keycode
+ * that means something can be stored.
+ * With DYNAMIC_KEYMAP_CACHE_LAYERS, the highest active layers are mirrored
+ * in RAM so lookups don't touch EEPROM.
+ *
+ * A host rewrites the map with the commands below, over raw HID or the API
+ * sysex channel. Raw HID belongs to the keymap, so its raw_hid_receive()
+ * has to hand the reports to dynamic_keymap_raw_hid_receive(). Writes only happen between BEGIN and COMMIT, and until a
+ * COMMIT whose checksum matches, the keyboard runs on the flash keymap, so
+ * a half written layout is never used.
+ */
+
+#ifndef DYNAMIC_KEYMAP_LAYER_COUNT
+#define DYNAMIC_KEYMAP_LAYER_COUNT 4
+#endif
+
+/* Layers mirrored in RAM, MATRIX_ROWS * MATRIX_COLS * 2 bytes each: 300
+ * bytes of a 32U4's 2.5K for two layers of a 5x15 board. AVR reads its
+ * EEPROM about as fast as RAM, so there the default is none. */
+#ifndef DYNAMIC_KEYMAP_CACHE_LAYERS
+  #ifdef __AVR__
+    #define DYNAMIC_KEYMAP_CACHE_LAYERS 0
+  #else
+    #define DYNAMIC_KEYMAP_CACHE_LAYERS 2
+  #endif
+#endif
+
+// DYNAMIC_MACRO_EEPROM goes after it by default
+#ifndef DYNAMIC_KEYMAP_EEPROM_ADDR
+#define DYNAMIC_KEYMAP_EEPROM_ADDR 32
+#endif
+
+#define DYNAMIC_KEYMAP_FLASH 0x5FFF
+
+// Keymap bytes: keycodes big endian, layer by layer, row by row
+#define DYNAMIC_KEYMAP_SIZE (DYNAMIC_KEYMAP_LAYER_COUNT * MATRIX_ROWS * MATRIX_COLS * 2)
+// First byte past the magic, CRC and keymap bytes
+#define DYNAMIC_KEYMAP_EEPROM_END (DYNAMIC_KEYMAP_EEPROM_ADDR + 4 + DYNAMIC_KEYMAP_SIZE)
+
+/* Commands, as the first byte of a request. Every response starts with the
+ * command and a status byte.
+ *
+ *   GET_INFO                       -> layers, rows, cols, committed
+ *   READ    offset(2) length       -> offset(2) length data...
+ *   BEGIN
+ *   WRITE   offset(2) length data...
+ *   COMMIT  crc(2)                    CRC-16/CCITT of all keymap bytes
+ *   RESET                             back to the flash keymap
+ */
+enum dynamic_keymap_command {
+  DYNAMIC_KEYMAP_GET_INFO = 0x01,
+  DYNAMIC_KEYMAP_READ,
+  DYNAMIC_KEYMAP_BEGIN,
+  DYNAMIC_KEYMAP_WRITE,
+  DYNAMIC_KEYMAP_COMMIT,
+  DYNAMIC_KEYMAP_RESET,
+};
+
+enum dynamic_keymap_status {
+  DYNAMIC_KEYMAP_OK = 0x00,
+  DYNAMIC_KEYMAP_BAD_RANGE,
+  DYNAMIC_KEYMAP_NO_TRANSACTION,
+  DYNAMIC_KEYMAP_BAD_CHECKSUM,
+  DYNAMIC_KEYMAP_UNKNOWN = 0xFF,
+};
+
+void dynamic_keymap_init(void);
+uint16_t dynamic_keymap_get_keycode(uint8_t layer, uint8_t row, uint8_t col);
+
+/* Runs one request and writes the response, at most `size` bytes.
+ * Returns the response length. */
+uint8_t dynamic_keymap_command(const uint8_t *request, uint8_t length, uint8_t *response, uint8_t size);
+
+#ifdef RAW_ENABLE
+/* Runs a raw HID report as a request and sends the response back */
+void dynamic_keymap_raw_hid_receive(uint8_t *data, uint8_t length);
+#endif
+
+#endif
@@ -3,18 +3,72 @@
 #define DYNAMIC_MACROS_H
 
 #include "action_layer.h"
+#include "timer.h"
+#ifdef DYNAMIC_MACRO_EEPROM
+#include "eeprom.h"
+#endif
 
-#ifndef DYNAMIC_MACRO_SIZE
-/* May be overridden with a custom value. Be aware that the effective
- * macro length is half of this value: each keypress is recorded twice
- * because of the down-event and up-event. This is not a bug, it's the
- * intended behavior.
+#ifndef DYNAMIC_MACRO_BYTES
+/* May be overridden with a custom value. This is the size in bytes of
+ * the buffer shared by both macros.
  *
- * Usually it should be fine to set the macro size to at least 256 but
- * there have been reports of it being too much in some users' cases,
- * so 128 is considered a safe default.
+ * Every press and every release is recorded as its own event, packed
+ * as the key position plus the press/release bit (one byte on
+ * keyboards with up to 128 keys, two otherwise) followed by the time
+ * since the previous event in 7-bit groups. Most events fit in two
+ * bytes, so the default holds around 128 events, as many as the old
+ * 128 full keyrecord_t entries did in a third of the RAM.
  */
-#define DYNAMIC_MACRO_SIZE 128
+#ifdef DYNAMIC_MACRO_SIZE
+/* The old setting, counted in events; keep room for as many. */
+#define DYNAMIC_MACRO_BYTES (DYNAMIC_MACRO_SIZE * 2)
+#else
+#define DYNAMIC_MACRO_BYTES 256
+#endif
+#endif
+
+/* The recorded delays are stored in units of 2^DYNAMIC_MACRO_TIME_SHIFT
+ * milliseconds. The default of 4ms keeps most delays in a single byte.
+ */
+#ifndef DYNAMIC_MACRO_TIME_SHIFT
+#define DYNAMIC_MACRO_TIME_SHIFT 2
+#endif
+
+#if MATRIX_ROWS * MATRIX_COLS <= 128
+#define DYNAMIC_MACRO_KEY_BYTES 1
+#else
+#define DYNAMIC_MACRO_KEY_BYTES 2
+#endif
+/* Key bytes plus up to three bytes of delay. */
+#define DYNAMIC_MACRO_EVENT_MAX (DYNAMIC_MACRO_KEY_BYTES + 3)
+
+#ifdef DYNAMIC_MACRO_EEPROM
+/* With DYNAMIC_MACRO_EEPROM defined, both macros are saved to EEPROM
+ * when a recording ends and loaded back on startup. Only the bytes
+ * actually used are written, and only where they differ from what is
+ * already stored, so re-recording the same macro costs no EEPROM
+ * wear. DYNAMIC_MACRO_EEPROM_SIZE bytes starting at
+ * DYNAMIC_MACRO_EEPROM_ADDR are used, including a 5 byte header.
+ */
+#ifdef DYNAMIC_KEYMAP_ENABLE
+#include "dynamic_keymap.h"
+#endif
+#ifndef DYNAMIC_MACRO_EEPROM_ADDR
+#ifdef DYNAMIC_KEYMAP_ENABLE
+#define DYNAMIC_MACRO_EEPROM_ADDR DYNAMIC_KEYMAP_EEPROM_END
+#else
+#define DYNAMIC_MACRO_EEPROM_ADDR 32
+#endif
+#endif
+#ifndef DYNAMIC_MACRO_EEPROM_SIZE
+#define DYNAMIC_MACRO_EEPROM_SIZE (DYNAMIC_MACRO_BYTES + 5)
+#endif
+#if defined(DYNAMIC_KEYMAP_ENABLE) && \
+    DYNAMIC_MACRO_EEPROM_ADDR < DYNAMIC_KEYMAP_EEPROM_END && \
+    DYNAMIC_KEYMAP_EEPROM_ADDR < DYNAMIC_MACRO_EEPROM_ADDR + DYNAMIC_MACRO_EEPROM_SIZE
+#error "DYNAMIC_MACRO_EEPROM and DYNAMIC_KEYMAP overlap in EEPROM"
+#endif
+#define DYNAMIC_MACRO_EEPROM_MAGIC 0xD4
 #endif
 
 /* DYNAMIC_MACRO_RANGE must be set as the last element of user's
@@ -28,6 +82,59 @@ enum dynamic_macro_keycodes {
     DYN_MACRO_PLAY2,
 };
 
+/* Both macros use the same buffer but read/write on different
+ * ends of it.
+ *
+ * Macro1 is written left-to-right starting from the beginning of
+ * the buffer.
+ *
+ * Macro2 is written right-to-left starting from the end of the
+ * buffer. Its events are written byte by byte in the same order as
+ * macro1's, just walking the other way, so both are decoded by the
+ * same code with a different direction.
+ *
+ * &macro_buffer   macro_end
+ *  v                   v
+ * +------------------------------------------------------------+
+ * |>>>>>> MACRO1 >>>>>>|    |<<<<<<<<<<<<< MACRO2 <<<<<<<<<<<<<|
+ * +------------------------------------------------------------+
+ *                           ^                                 ^
+ *                         r_macro_end                  r_macro_buffer
+ *
+ * During the recording when one macro encounters the end of the
+ * other macro, the recording is stopped. Apart from this, there
+ * are no arbitrary limits for the macros' length in relation to
+ * each other: for example one can either have two medium sized
+ * macros or one long macro and one short macro. Or even one empty
+ * and one using the whole buffer.
+ */
+static uint8_t macro_buffer[DYNAMIC_MACRO_BYTES];
+
+/* Pointer to the first buffer element after the first macro.
+ * Initially points to the very beginning of the buffer since the
+ * macro is empty. */
+static uint8_t *macro_end = macro_buffer;
+
+/* The other end of the macro buffer. Serves as the beginning of
+ * the second macro. */
+static uint8_t *const r_macro_buffer = macro_buffer + DYNAMIC_MACRO_BYTES - 1;
+
+/* Like macro_end but for the second macro. */
+static uint8_t *r_macro_end = macro_buffer + DYNAMIC_MACRO_BYTES - 1;
+
+/* Time of the last recorded event, the next delay is relative to it. */
+static uint16_t dynamic_macro_record_time;
+static bool dynamic_macro_record_first;
+
+/* Playback state, dynamic_macro_task() advances it. */
+static uint8_t *dynamic_macro_play_pointer = NULL;
+static uint8_t *dynamic_macro_play_end;
+static int8_t dynamic_macro_play_direction;
+static keyevent_t dynamic_macro_play_event;
+static uint16_t dynamic_macro_play_delay;
+static uint16_t dynamic_macro_play_timer;
+static layer_state_t dynamic_macro_saved_layer_state;
+
 /* Blink the LEDs to notify the user about some event. */
 void dynamic_macro_led_blink(void)
 {
@@ -36,6 +143,147 @@ void dynamic_macro_led_blink(void)
     backlight_toggle();
 }
 
+/**
+ * Pack a key event into its stored form.
+ *
+ * @param[out] event  At least DYNAMIC_MACRO_EVENT_MAX bytes.
+ * @param[in]  record The key event to pack.
+ * @param[in]  delay  Milliseconds since the previous event.
+ * @return The number of bytes used.
+ */
+uint8_t dynamic_macro_encode(uint8_t *event, keyrecord_t *record, uint16_t delay)
+{
+    uint8_t len = 0;
+    uint8_t pressed = record->event.pressed ? 0x80 : 0;
+
+#if DYNAMIC_MACRO_KEY_BYTES == 1
+    event[len++] = pressed | (record->event.key.row * MATRIX_COLS + record->event.key.col);
+#else
+    event[len++] = record->event.key.row;
+    event[len++] = pressed | record->event.key.col;
+#endif
+
+    delay >>= DYNAMIC_MACRO_TIME_SHIFT;
+    do {
+        event[len] = delay & 0x7F;
+        delay >>= 7;
+        if (delay) {
+            event[len] |= 0x80;
+        }
+        len++;
+    } while (delay);
+
+    return len;
+}
+
+/**
+ * Unpack the event at the current position and advance past it.
+ *
+ * @param[in,out] macro_pointer The current buffer position.
+ * @param[in]     macro_end     The end of the macro being read.
+ * @param[in]     direction     Either +1 or -1, which way to iterate the buffer.
+ * @param[out]    event         The unpacked key event, without the time.
+ * @param[out]    delay         Milliseconds since the previous event.
+ * @return false when there are no more events.
+ */
+bool dynamic_macro_decode(
+    uint8_t **macro_pointer, uint8_t *macro_end, int8_t direction,
+    keyevent_t *event, uint16_t *delay)
+{
+    uint8_t *p = *macro_pointer;
+    uint8_t byte;
+
+    if (p == macro_end) {
+        return false;
+    }
+
+#if DYNAMIC_MACRO_KEY_BYTES == 1
+    byte = *p; p += direction;
+    event->key.row = (byte & 0x7F) / MATRIX_COLS;
+    event->key.col = (byte & 0x7F) % MATRIX_COLS;
+#else
+    event->key.row = *p; p += direction;
+    byte = *p; p += direction;
+    event->key.col = byte & 0x7F;
+#endif
+    event->pressed = (byte & 0x80) != 0;
+
+    *delay = 0;
+    for (uint8_t shift = 0; p != macro_end; shift += 7) {
+        byte = *p; p += direction;
+        *delay |= (uint16_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+    *delay <<= DYNAMIC_MACRO_TIME_SHIFT;
+
+    *macro_pointer = p;
+    return true;
+}
+
+#ifdef DYNAMIC_MACRO_EEPROM
+/* EEPROM layout: magic, macro1 length (2 bytes), macro2 length (2
+ * bytes), macro1 bytes, macro2 bytes. Macro2 is stored in buffer
+ * order, i.e. starting from its last byte. */
+#define DYNAMIC_MACRO_EEPROM_HEADER ((uint8_t *)DYNAMIC_MACRO_EEPROM_ADDR)
+#define DYNAMIC_MACRO_EEPROM_LEN1   ((uint16_t *)(DYNAMIC_MACRO_EEPROM_ADDR + 1))
+#define DYNAMIC_MACRO_EEPROM_LEN2   ((uint16_t *)(DYNAMIC_MACRO_EEPROM_ADDR + 3))
+#define DYNAMIC_MACRO_EEPROM_DATA   ((uint8_t *)(DYNAMIC_MACRO_EEPROM_ADDR + 5))
+
+void dynamic_macro_save(void)
+{
+    uint16_t len1 = macro_end - macro_buffer;
+    uint16_t len2 = r_macro_buffer - r_macro_end;
+
+    if (len1 + len2 > DYNAMIC_MACRO_EEPROM_SIZE - 5) {
+        dynamic_macro_led_blink();
+        return;
+    }
+
+    /* Invalidate first so a reset halfway through never loads a
+     * half-written macro. */
+    eeprom_update_byte(DYNAMIC_MACRO_EEPROM_HEADER, 0xFF);
+    eeprom_update_block(macro_buffer, DYNAMIC_MACRO_EEPROM_DATA, len1);
+    eeprom_update_block(r_macro_end + 1, DYNAMIC_MACRO_EEPROM_DATA + len1, len2);
+    eeprom_update_word(DYNAMIC_MACRO_EEPROM_LEN1, len1);
+    eeprom_update_word(DYNAMIC_MACRO_EEPROM_LEN2, len2);
+    eeprom_update_byte(DYNAMIC_MACRO_EEPROM_HEADER, DYNAMIC_MACRO_EEPROM_MAGIC);
+}
+
+void dynamic_macro_load(void)
+{
+    if (eeprom_read_byte(DYNAMIC_MACRO_EEPROM_HEADER) != DYNAMIC_MACRO_EEPROM_MAGIC) {
+        return;
+    }
+
+    uint16_t len1 = eeprom_read_word(DYNAMIC_MACRO_EEPROM_LEN1);
+    uint16_t len2 = eeprom_read_word(DYNAMIC_MACRO_EEPROM_LEN2);
+
+    /* Keep the one byte gap between the macros. */
+    if (len1 + len2 >= DYNAMIC_MACRO_BYTES) {
+        return;
+    }
+
+    eeprom_read_block(macro_buffer, DYNAMIC_MACRO_EEPROM_DATA, len1);
+    macro_end = macro_buffer + len1;
+    r_macro_end = r_macro_buffer - len2;
+    eeprom_read_block(r_macro_end + 1, DYNAMIC_MACRO_EEPROM_DATA + len1, len2);
+}
+#endif
+
+void dynamic_macro_init(void)
+{
+    static bool initialized = false;
+
+    if (!initialized) {
+        initialized = true;
+#ifdef DYNAMIC_MACRO_EEPROM
+        dynamic_macro_load();
+#endif
+    }
+}
+
 /**
  * Start recording of the dynamic macro.
  *
@@ -43,38 +291,77 @@ void dynamic_macro_led_blink(void)
  * @param[in]  macro_buffer  The macro buffer used to initialize macro_pointer.
  */
 void dynamic_macro_record_start(
-    keyrecord_t **macro_pointer, keyrecord_t *macro_buffer)
+    uint8_t **macro_pointer, uint8_t *macro_buffer)
 {
     dynamic_macro_led_blink();
 
     clear_keyboard();
     layer_clear();
     *macro_pointer = macro_buffer;
+    dynamic_macro_record_first = true;
 }
 
 /**
- * Play the dynamic macro.
+ * Start playing the dynamic macro. The events are replayed by
+ * dynamic_macro_task() with their recorded timing.
  *
  * @param macro_buffer[in] The beginning of the macro buffer being played.
  * @param macro_end[in]    The element after the last macro buffer element.
  * @param direction[in]    Either +1 or -1, which way to iterate the buffer.
  */
 void dynamic_macro_play(
-    keyrecord_t *macro_buffer, keyrecord_t *macro_end, int8_t direction)
+    uint8_t *macro_buffer, uint8_t *macro_end, int8_t direction)
 {
-    uint32_t saved_layer_state = layer_state;
+    if (dynamic_macro_play_pointer) {
+        return;
+    }
+
+    if (!dynamic_macro_decode(&macro_buffer, macro_end, direction,
+                              &dynamic_macro_play_event, &dynamic_macro_play_delay)) {
+        return;
+    }
+
+    dynamic_macro_saved_layer_state = layer_state;
 
     clear_keyboard();
     layer_clear();
 
-    while (macro_buffer != macro_end) {
-        process_record(macro_buffer);
-        macro_buffer += direction;
+    dynamic_macro_play_pointer = macro_buffer;
+    dynamic_macro_play_end = macro_end;
+    dynamic_macro_play_direction = direction;
+    dynamic_macro_play_delay = 0;
+    dynamic_macro_play_timer = timer_read();
+}
+
+/**
+ * Replay the next event of the macro being played once its delay has
+ * passed. Called from matrix_scan_quantum(), no need to call it from
+ * the keymap.
+ */
+void dynamic_macro_task(void)
+{
+    dynamic_macro_init();
+
+    if (!dynamic_macro_play_pointer ||
+        timer_elapsed(dynamic_macro_play_timer) < dynamic_macro_play_delay) {
+        return;
     }
 
-    clear_keyboard();
+    /* Advance by the recorded delay rather than to now so that the
+     * timing does not drift with the scan rate. */
+    dynamic_macro_play_timer += dynamic_macro_play_delay;
+    dynamic_macro_play_event.time = (timer_read() | 1);
+    action_exec(dynamic_macro_play_event);
+
+    if (!dynamic_macro_decode(&dynamic_macro_play_pointer, dynamic_macro_play_end,
+                              dynamic_macro_play_direction,
+                              &dynamic_macro_play_event, &dynamic_macro_play_delay)) {
+        dynamic_macro_play_pointer = NULL;
+
+        clear_keyboard();
 
-    layer_state = saved_layer_state;
+        layer_state = dynamic_macro_saved_layer_state;
+    }
 }
 
 /**
@@ -86,14 +373,29 @@ void dynamic_macro_play(
  * @param record[in]     The current keypress.
  */
 void dynamic_macro_record_key(
-    keyrecord_t **macro_pointer,
-    keyrecord_t *macro_end2,
+    uint8_t **macro_pointer,
+    uint8_t *macro_end2,
     int8_t direction,
     keyrecord_t *record)
 {
-    if (*macro_pointer + direction != macro_end2) {
-        **macro_pointer = *record;
-        *macro_pointer += direction;
+    uint8_t event[DYNAMIC_MACRO_EVENT_MAX];
+    uint16_t delay = 0;
+
+    if (!dynamic_macro_record_first) {
+        delay = KEYEVENT_TIME_DIFF(record->event.time, dynamic_macro_record_time);
+    }
+
+    uint8_t len = dynamic_macro_encode(event, record, delay);
+    uint16_t free = (direction > 0) ? macro_end2 - *macro_pointer
+                                    : *macro_pointer - macro_end2;
+
+    if (len < free) {
+        for (uint8_t i = 0; i < len; i++) {
+            **macro_pointer = event[i];
+            *macro_pointer += direction;
+        }
+        dynamic_macro_record_time = record->event.time;
+        dynamic_macro_record_first = false;
     } else {
         /* Notify about the end of buffer. The blinks are paired
          * because they should happen on both down and up events. */
@@ -105,11 +407,15 @@ void dynamic_macro_record_key(
  * End recording of the dynamic macro. Essentially just update the
  * pointer to the end of the macro.
  */
-void dynamic_macro_record_end(keyrecord_t *macro_pointer, keyrecord_t **macro_end)
+void dynamic_macro_record_end(uint8_t *macro_pointer, uint8_t **macro_end)
 {
     dynamic_macro_led_blink();
 
     *macro_end = macro_pointer;
+
+#ifdef DYNAMIC_MACRO_EEPROM
+    dynamic_macro_save();
+#endif
 }
 
 /* Handle the key events related to the dynamic macros. Should be
@@ -124,63 +430,31 @@ void dynamic_macro_record_end(keyrecord_t *macro_pointer, keyrecord_t **macro_en
  */
 bool process_record_dynamic_macro(uint16_t keycode, keyrecord_t *record)
 {
-    /* Both macros use the same buffer but read/write on different
-     * ends of it.
-     *
-     * Macro1 is written left-to-right starting from the beginning of
-     * the buffer.
-     *
-     * Macro2 is written right-to-left starting from the end of the
-     * buffer.
-     *
-     * &macro_buffer   macro_end
-     *  v                   v
-     * +------------------------------------------------------------+
-     * |>>>>>> MACRO1 >>>>>>|    |<<<<<<<<<<<<< MACRO2 <<<<<<<<<<<<<|
-     * +------------------------------------------------------------+
-     *                           ^                                 ^
-     *                         r_macro_end                  r_macro_buffer
-     *
-     * During the recording when one macro encounters the end of the
-     * other macro, the recording is stopped. Apart from this, there
-     * are no arbitrary limits for the macros' length in relation to
-     * each other: for example one can either have two medium sized
-     * macros or one long macro and one short macro. Or even one empty
-     * and one using the whole buffer.
-     */
-    static keyrecord_t macro_buffer[DYNAMIC_MACRO_SIZE];
-
-    /* Pointer to the first buffer element after the first macro.
-     * Initially points to the very beginning of the buffer since the
-     * macro is empty. */
-    static keyrecord_t *macro_end = macro_buffer;
-
-    /* The other end of the macro buffer. Serves as the beginning of
-     * the second macro. */
-    static keyrecord_t *const r_macro_buffer = macro_buffer + DYNAMIC_MACRO_SIZE - 1;
-
-    /* Like macro_end but for the second macro. */
-    static keyrecord_t *r_macro_end = r_macro_buffer;
-
     /* A persistent pointer to the current macro position (iterator)
      * used during the recording. */
-    static keyrecord_t *macro_pointer = NULL;
+    static uint8_t *macro_pointer = NULL;
 
     /* 0   - no macro is being recorded right now
      * 1,2 - either macro 1 or 2 is being recorded */
     static uint8_t macro_id = 0;
 
+    dynamic_macro_init();
+
     if (macro_id == 0) {
         /* No macro recording in progress. */
         if (!record->event.pressed) {
             switch (keycode) {
             case DYN_REC_START1:
-                dynamic_macro_record_start(&macro_pointer, macro_buffer);
-                macro_id = 1;
+                if (!dynamic_macro_play_pointer) {
+                    dynamic_macro_record_start(&macro_pointer, macro_buffer);
+                    macro_id = 1;
+                }
                 return false;
             case DYN_REC_START2:
-                dynamic_macro_record_start(&macro_pointer, r_macro_buffer);
-                macro_id = 2;
+                if (!dynamic_macro_play_pointer) {
+                    dynamic_macro_record_start(&macro_pointer, r_macro_buffer);
+                    macro_id = 2;
+                }
                 return false;
             case DYN_MACRO_PLAY1:
                 dynamic_macro_play(macro_buffer, macro_end, +1);
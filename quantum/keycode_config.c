@@ -2,7 +2,17 @@
 
 extern keymap_config_t keymap_config;
 
-uint16_t keycode_config(uint16_t keycode) {
+/* keymap_config only ever changes these keycodes, which sit in two short
+ * runs plus KC_LOCKING_CAPS. Each has an entry holding keycode ^ remapped,
+ * so the all-zero table is the identity until the first update. */
+#define REMAP_LOW_FIRST KC_ESCAPE
+#define REMAP_LOW_LAST  KC_CAPSLOCK
+
+static uint8_t remap_low[REMAP_LOW_LAST - REMAP_LOW_FIRST + 1];
+static uint8_t remap_mods[KC_RGUI - KC_LCTRL + 1];
+static uint8_t remap_locking_caps;
+
+static uint16_t remap_keycode(uint16_t keycode) {
 
     switch (keycode) {
         case KC_CAPSLOCK:
@@ -71,4 +81,31 @@ uint16_t keycode_config(uint16_t keycode) {
         default:
             return keycode;
     }
-}
\ No newline at end of file
+}
+
+void keycode_config_update(void) {
+    for (uint8_t i = 0; i < sizeof(remap_low); i++) {
+        remap_low[i] = (REMAP_LOW_FIRST + i) ^ remap_keycode(REMAP_LOW_FIRST + i);
+    }
+    for (uint8_t i = 0; i < sizeof(remap_mods); i++) {
+        remap_mods[i] = (KC_LCTRL + i) ^ remap_keycode(KC_LCTRL + i);
+    }
+    remap_locking_caps = KC_LOCKING_CAPS ^ remap_keycode(KC_LOCKING_CAPS);
+}
+
+void keymap_config_changed(void) {
+    keycode_config_update();
+}
+
+uint16_t keycode_config(uint16_t keycode) {
+    if ((uint16_t)(keycode - REMAP_LOW_FIRST) < sizeof(remap_low)) {
+        return keycode ^ remap_low[keycode - REMAP_LOW_FIRST];
+    }
+    if ((uint16_t)(keycode - KC_LCTRL) < sizeof(remap_mods)) {
+        return keycode ^ remap_mods[keycode - KC_LCTRL];
+    }
+    if (keycode == KC_LOCKING_CAPS) {
+        return keycode ^ remap_locking_caps;
+    }
+    return keycode;
+}
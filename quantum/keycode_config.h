@@ -6,6 +6,11 @@
 
 uint16_t keycode_config(uint16_t keycode);
 
+/* Rebuilds the remap table from keymap_config. keymap_config_changed(),
+ * which eeconfig_update_keymap() calls, does it here; anything else
+ * changing keymap_config has to as well. */
+void keycode_config_update(void);
+
 /* NOTE: Not portable. Bit field order depends on implementation */
 typedef union {
     uint16_t raw;
@@ -42,6 +42,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 uint16_t keymap_key_to_keycode(uint8_t layer, keypos_t key);
 
 extern const uint16_t keymaps[][MATRIX_ROWS][MATRIX_COLS];
+
+#ifdef SPARSE_KEYMAP_ENABLE
+#include "matrix.h"
+
+/* generated from keymaps[] at build time, see util/sparse_keymap.sh */
+extern const uint8_t sparse_keymap_layers;
+extern const matrix_row_t sparse_keymap_bits[][MATRIX_ROWS];
+extern const uint16_t sparse_keymap_offsets[][MATRIX_ROWS];
+extern const uint16_t sparse_keymap_keycodes[];
+#endif
 extern const uint16_t fn_actions[];
 
 enum quantum_keycodes {
@@ -76,10 +86,6 @@ enum quantum_keycodes {
     QK_ONE_SHOT_LAYER_MAX = 0x54FF,
     QK_ONE_SHOT_MOD       = 0x5500,
     QK_ONE_SHOT_MOD_MAX   = 0x55FF,
-#ifndef DISABLE_CHORDING
-    QK_CHORDING           = 0x5600,
-    QK_CHORDING_MAX       = 0x56FF,
-#endif
     QK_MOD_TAP            = 0x6000,
     QK_MOD_TAP_MAX        = 0x6FFF,
     QK_TAP_DANCE          = 0x7100,
@@ -299,15 +305,10 @@ enum quantum_keycodes {
 #define MI_ON MIDI_ON
 #define MI_OFF MIDI_OFF
 
-// GOTO layer - 16 layers max
-// when:
-// ON_PRESS    = 1
-// ON_RELEASE  = 2
-// Unless you have a good reason not to do so, prefer  ON_PRESS (1) as your default.
-// In fact, we changed it to assume ON_PRESS for sanity/simplicity. If needed, you can add your own
-// keycode modeled after the old version, kept below for this.
-/* #define TO(layer, when) (layer | QK_TO | (when << 0x4)) */
-#define TO(layer) (layer | QK_TO | (ON_PRESS << 0x4))
+// GOTO layer - MAX_LAYER layers, 64 at most
+// Always acts on press. The layer used to share the low byte with a "when"
+// field, which limited TO() to 16 layers.
+#define TO(layer) (layer | QK_TO)
 
 // Momentary switch layer - 256 layer max
 #define MO(layer) (layer | QK_MOMENTARY)
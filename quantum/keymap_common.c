@@ -19,6 +19,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "report.h"
 #include "keycode.h"
 #include "action_layer.h"
+#include "util.h"
 #if defined(__AVR__)
 #include <util/delay.h>
 #include <stdio.h>
@@ -37,20 +38,53 @@ extern keymap_config_t keymap_config;
 
 #include <inttypes.h>
 
+#ifdef SPARSE_KEYMAP_ENABLE
+/* positions of one row of a layer that are not KC_TRNS */
+static matrix_row_t sparse_keymap_row(uint8_t layer, uint8_t row)
+{
+    if (layer >= sparse_keymap_layers)
+        return 0;
+#if (MATRIX_COLS <= 8)
+    return pgm_read_byte(&sparse_keymap_bits[layer][row]);
+#elif (MATRIX_COLS <= 16)
+    return pgm_read_word(&sparse_keymap_bits[layer][row]);
+#else
+    return pgm_read_dword(&sparse_keymap_bits[layer][row]);
+#endif
+}
+#endif
+
 /* converts key to action */
 action_t action_for_key(uint8_t layer, keypos_t key)
 {
+    action_t action;
+
+#if defined(SPARSE_KEYMAP_ENABLE) && !defined(DYNAMIC_KEYMAP_ENABLE)
+    // layers with no entry for this key are skipped outright
+    if (!(sparse_keymap_row(layer, key.row) & ((matrix_row_t)1 << key.col))) {
+        action.code = ACTION_TRANSPARENT;
+        return action;
+    }
+#endif
+
     // 16bit keycodes - important
     uint16_t keycode = keymap_key_to_keycode(layer, key);
 
     // keycode remapping
     keycode = keycode_config(keycode);
 
-    action_t action;
     uint8_t action_layer, when, mod;
     // The arm-none-eabi compiler generates out of bounds warnings when using the fn_actions directly for some reason
     const uint16_t* actions = fn_actions;
 
+#if MAX_LAYER > 32
+    // no action code can hold these layers, process_record_quantum does them
+    if (keycode >= QK_TO && keycode <= QK_ONE_SHOT_LAYER_MAX && (keycode & 0xFF) >= 32) {
+        action.code = ACTION_NO;
+        return action;
+    }
+#endif
+
     switch (keycode) {
         case KC_FN0 ... KC_FN31:
             action.code = pgm_read_word(&actions[FN_INDEX(keycode)]);
@@ -89,8 +123,8 @@ action_t action_for_key(uint8_t layer, keypos_t key)
             break;
         case QK_TO ... QK_TO_MAX: ;
             // Layer set "GOTO"
-            when = (keycode >> 0x4) & 0x3;
-            action_layer = keycode & 0xF;
+            when = ON_PRESS;
+            action_layer = keycode & 0xFF;
             action.code = ACTION_LAYER_SET(action_layer, when);
             break;
         case QK_MOMENTARY ... QK_MOMENTARY_MAX: ;
@@ -166,6 +200,30 @@ void action_function(keyrecord_t *record, uint8_t id, uint8_t opt)
 /* translates key to keycode */
 uint16_t keymap_key_to_keycode(uint8_t layer, keypos_t key)
 {
+#ifdef DYNAMIC_KEYMAP_ENABLE
+    if (layer < DYNAMIC_KEYMAP_LAYER_COUNT) {
+        uint16_t keycode = dynamic_keymap_get_keycode(layer, key.row, key.col);
+        if (keycode != DYNAMIC_KEYMAP_FLASH)
+            return keycode;
+    }
+#endif
+#ifdef SPARSE_KEYMAP_ENABLE
+    matrix_row_t bits = sparse_keymap_row(layer, key.row);
+    matrix_row_t bit = (matrix_row_t)1 << key.col;
+    if (!(bits & bit))
+        return KC_TRNS;
+    // the keycode's index is the number of set positions before it
+    uint16_t index = pgm_read_word(&sparse_keymap_offsets[layer][key.row]);
+#if (MATRIX_COLS <= 8)
+    index += bitpop(bits & (bit - 1));
+#elif (MATRIX_COLS <= 16)
+    index += bitpop16(bits & (bit - 1));
+#else
+    index += bitpop32(bits & (bit - 1));
+#endif
+    return pgm_read_word(&sparse_keymap_keycodes[index]);
+#else
     // Read entire word (16bits)
     return pgm_read_word(&keymaps[(layer)][(key.row)][(key.col)]);
+#endif
 }
@@ -0,0 +1,217 @@
+#include "process_combo.h"
+
+#define COMBO_BUCKETS (1 << COMBO_HASH_BITS)
+#define COMBO_BUCKET(hash) ((uint16_t)(hash) >> (16 - COMBO_HASH_BITS))
+
+#define KEY_ROW(k) ((k) / MATRIX_COLS)
+#define KEY_BIT(k) ((matrix_row_t)1 << ((k) % MATRIX_COLS))
+
+// Hashed index: first combo of every bucket, then a chain through the table
+static combo_index_t buckets[COMBO_BUCKETS];
+static combo_index_t chain[COMBO_COUNT];
+
+// Combos that are part of a bigger combo have to wait for it
+static uint8_t superset[(COMBO_COUNT + 7) / 8];
+// Buckets holding a proper subset of some combo, so more keys may follow
+static uint8_t partial[(COMBO_BUCKETS + 7) / 8];
+// Every matrix position used by at least one combo
+static matrix_row_t combo_keys[MATRIX_ROWS];
+
+// Presses swallowed while waiting for a combo to complete
+static keyrecord_t pending[COMBO_MAX_KEYS];
+static uint8_t pending_count = 0;
+static uint16_t pending_hash = 0;
+static matrix_row_t pending_keys[MATRIX_ROWS];
+static combo_index_t candidate = COMBO_NONE;
+
+// Combo whose keycode is registered, and the keys still held for it
+static combo_index_t active = COMBO_NONE;
+static matrix_row_t active_keys[MATRIX_ROWS];
+
+static bool replaying = false;
+
+static inline bool bit_test(const uint8_t *bits, uint16_t n) {
+  return bits[n / 8] & (1 << (n % 8));
+}
+
+static inline void bit_set(uint8_t *bits, uint16_t n) {
+  bits[n / 8] |= 1 << (n % 8);
+}
+
+static uint8_t combo_count(combo_index_t i) {
+  return pgm_read_byte(&key_combos[i].count);
+}
+
+static combo_key_t combo_key(combo_index_t i, uint8_t n) {
+  if (sizeof(combo_key_t) == 1)
+    return pgm_read_byte(&key_combos[i].keys[n]);
+  return pgm_read_word(&key_combos[i].keys[n]);
+}
+
+// True if the combo consists of exactly the `count` keys in `keys`
+static bool combo_is(combo_index_t i, const matrix_row_t *keys, uint8_t count) {
+  if (combo_count(i) != count)
+    return false;
+  for (uint8_t n = 0; n < count; n++) {
+    combo_key_t key = combo_key(i, n);
+    if (!(keys[KEY_ROW(key)] & KEY_BIT(key)))
+      return false;
+  }
+  return true;
+}
+
+static combo_index_t combo_lookup(uint16_t hash, const matrix_row_t *keys, uint8_t count) {
+  for (combo_index_t i = buckets[COMBO_BUCKET(hash)]; i != COMBO_NONE; i = chain[i]) {
+    if (pgm_read_word(&key_combos[i].hash) == hash && combo_is(i, keys, count))
+      return i;
+  }
+  return COMBO_NONE;
+}
+
+void combo_init(void) {
+  for (uint16_t b = 0; b < COMBO_BUCKETS; b++) {
+    buckets[b] = COMBO_NONE;
+  }
+  // walk backwards so the chains keep table order
+  for (combo_index_t i = COMBO_COUNT; i-- > 0;) {
+    uint16_t b = COMBO_BUCKET(pgm_read_word(&key_combos[i].hash));
+    chain[i] = buckets[b];
+    buckets[b] = i;
+  }
+
+  // Visit every proper subset of every combo once. Bounded by
+  // 2^COMBO_MAX_KEYS per combo, so it stays linear in the table size.
+  for (combo_index_t i = 0; i < COMBO_COUNT; i++) {
+    combo_key_t keys[COMBO_MAX_KEYS];
+    uint8_t n = combo_count(i);
+    for (uint8_t j = 0; j < n; j++) {
+      keys[j] = combo_key(i, j);
+      combo_keys[KEY_ROW(keys[j])] |= KEY_BIT(keys[j]);
+    }
+    for (uint16_t set = 1; set < (1U << n) - 1; set++) {
+      matrix_row_t subset[MATRIX_ROWS] = {0};
+      uint16_t hash = 0;
+      uint8_t count = 0;
+      for (uint8_t j = 0; j < n; j++) {
+        if (set & (1 << j)) {
+          subset[KEY_ROW(keys[j])] |= KEY_BIT(keys[j]);
+          hash ^= COMBO_KEY_HASH(keys[j]);
+          count++;
+        }
+      }
+      bit_set(partial, COMBO_BUCKET(hash));
+      combo_index_t smaller = combo_lookup(hash, subset, count);
+      if (smaller != COMBO_NONE)
+        bit_set(superset, smaller);
+    }
+  }
+}
+
+static void pending_clear(void) {
+  for (uint8_t r = 0; r < MATRIX_ROWS; r++) {
+    pending_keys[r] = 0;
+  }
+  pending_count = 0;
+  pending_hash = 0;
+  candidate = COMBO_NONE;
+}
+
+static void combo_release(void) {
+  if (active != COMBO_NONE) {
+    unregister_code16(pgm_read_word(&key_combos[active].keycode));
+    active = COMBO_NONE;
+  }
+}
+
+static void combo_fire(combo_index_t i) {
+  combo_release();
+  for (uint8_t r = 0; r < MATRIX_ROWS; r++) {
+    active_keys[r] |= pending_keys[r];
+  }
+  pending_clear();
+  active = i;
+  register_code16(pgm_read_word(&key_combos[i].keycode));
+}
+
+// Not a combo after all: hand the swallowed presses on in order
+static void combo_flush(void) {
+  uint8_t count = pending_count;
+  pending_clear();
+  replaying = true;
+  for (uint8_t i = 0; i < count; i++) {
+    process_record(&pending[i]);
+  }
+  replaying = false;
+}
+
+static void combo_resolve(void) {
+  if (!pending_count)
+    return;
+  if (candidate != COMBO_NONE) {
+    combo_fire(candidate);
+  } else {
+    combo_flush();
+  }
+}
+
+bool process_combo(uint16_t keycode, keyrecord_t *record) {
+  // combos are made of positions, whatever their keycodes
+  (void)keycode;
+
+  if (replaying)
+    return true;
+
+  keypos_t key = record->event.key;
+  matrix_row_t bit = (matrix_row_t)1 << key.col;
+  uint16_t key_hash = COMBO_KEY_HASH(KP(key.row, key.col));
+
+  if (!record->event.pressed) {
+    // anything let go ends the window, otherwise events would be reordered
+    combo_resolve();
+    if (active_keys[key.row] & bit) {
+      active_keys[key.row] &= ~bit;
+      combo_release();
+      return false;
+    }
+    return true;
+  }
+
+  if (!(combo_keys[key.row] & bit)) {
+    combo_resolve();
+    return true;
+  }
+
+  if (pending_count) {
+    // if this key can't extend the pending keys, settle them and start over
+    uint16_t hash = pending_hash ^ key_hash;
+    bool grows = false;
+    if (pending_count < COMBO_MAX_KEYS) {
+      pending_keys[key.row] |= bit;
+      grows = bit_test(partial, COMBO_BUCKET(hash)) ||
+              combo_lookup(hash, pending_keys, pending_count + 1) != COMBO_NONE;
+      pending_keys[key.row] &= ~bit;
+    }
+    if (!grows)
+      combo_resolve();
+  }
+
+  pending[pending_count++] = *record;
+  pending_keys[key.row] |= bit;
+  pending_hash ^= key_hash;
+
+  combo_index_t match = combo_lookup(pending_hash, pending_keys, pending_count);
+  if (match != COMBO_NONE && !bit_test(superset, match)) {
+    combo_fire(match);
+  } else {
+    candidate = match;
+    if (match == COMBO_NONE && !bit_test(partial, COMBO_BUCKET(pending_hash)))
+      combo_flush();
+  }
+  return false;
+}
+
+void matrix_scan_combo(void) {
+  if (pending_count && KEYEVENT_ELAPSED(pending[0].event) > COMBO_TERM) {
+    combo_resolve();
+  }
+}
@@ -0,0 +1,95 @@
+#ifndef PROCESS_COMBO_H
+#define PROCESS_COMBO_H
+
+#include "quantum.h"
+
+/* Combos
+ *
+ * A combo is a set of up to COMBO_MAX_KEYS matrix positions that, pressed
+ * together within COMBO_TERM, send a single keycode instead. The table is
+ * built at compile time in the keymap:
+ *
+ *   const combo_t PROGMEM key_combos[COMBO_COUNT] = {
+ *     COMBO(KC_ESC,  KP(0, 1), KP(0, 2)),
+ *     COMBO(KC_TAB,  KP(0, 1), KP(0, 2), KP(0, 3)),
+ *   };
+ *
+ * with COMBO_COUNT defined in config.h. A combo with more than
+ * COMBO_MAX_KEYS keys fails to build. Every combo carries a hash of its
+ * key set, computed by the compiler, and the engine keeps the same hash for
+ * the keys currently pending, so finding the matching combo is one bucket
+ * lookup no matter how many combos there are.
+ */
+
+#ifndef COMBO_COUNT
+#error "COMBO_ENABLE needs COMBO_COUNT defined in config.h"
+#endif
+
+// Window (ms) in which all keys of a combo have to be pressed
+#ifndef COMBO_TERM
+#define COMBO_TERM 50
+#endif
+
+// The index has 2^COMBO_HASH_BITS buckets
+#ifndef COMBO_HASH_BITS
+#define COMBO_HASH_BITS 6
+#endif
+
+// Keys per combo, at most 8
+#ifndef COMBO_MAX_KEYS
+#define COMBO_MAX_KEYS 4
+#endif
+#if COMBO_MAX_KEYS > 8
+#error "COMBO_MAX_KEYS can be 8 at most"
+#endif
+
+// Matrix position of a key, as used in the combo table
+#define KP(row, col) ((row) * MATRIX_COLS + (col))
+
+#if MATRIX_ROWS * MATRIX_COLS <= 0x100
+typedef uint8_t combo_key_t;
+#else
+typedef uint16_t combo_key_t;
+#endif
+
+#define COMBO_KEY_HASH(key) ((uint16_t)(((key) + 1) * 40503U))
+
+// Number of arguments, up to 16
+#define COMBO_NARGS(...) COMBO_NARGS_(__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)
+#define COMBO_NARGS_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, n, ...) n
+
+// Padded with -1, which hashes to 0
+#define COMBO_HASH_(a, b, c, d, e, f, g, h, ...) \
+  (uint16_t)(COMBO_KEY_HASH(a) ^ COMBO_KEY_HASH(b) ^ COMBO_KEY_HASH(c) ^ COMBO_KEY_HASH(d) ^ \
+             COMBO_KEY_HASH(e) ^ COMBO_KEY_HASH(f) ^ COMBO_KEY_HASH(g) ^ COMBO_KEY_HASH(h))
+
+// The size of an array of -1 elements stops the build on too many keys
+#define COMBO(kc, ...) { \
+  .keys = { __VA_ARGS__ }, \
+  .count = sizeof(char[COMBO_NARGS(__VA_ARGS__) <= COMBO_MAX_KEYS ? COMBO_NARGS(__VA_ARGS__) : -1]), \
+  .hash = COMBO_HASH_(__VA_ARGS__, -1, -1, -1, -1, -1, -1, -1, -1), \
+  .keycode = kc, \
+}
+
+#if COMBO_COUNT < 0xFF
+typedef uint8_t combo_index_t;
+#define COMBO_NONE 0xFF
+#else
+typedef uint16_t combo_index_t;
+#define COMBO_NONE 0xFFFF
+#endif
+
+typedef struct {
+  combo_key_t keys[COMBO_MAX_KEYS];
+  uint8_t count;
+  uint16_t hash;
+  uint16_t keycode;
+} combo_t;
+
+extern const combo_t key_combos[COMBO_COUNT];
+
+void combo_init(void);
+bool process_combo(uint16_t keycode, keyrecord_t *record);
+void matrix_scan_combo(void);
+
+#endif
@@ -1,3 +1,4 @@
+#include <stddef.h>
 #include "process_leader.h"
 
 __attribute__ ((weak))
@@ -13,11 +14,100 @@ uint16_t leader_time = 0;
 uint16_t leader_sequence[5] = {0, 0, 0, 0, 0};
 uint8_t leader_sequence_size = 0;
 
+#ifdef LEADER_SEQUENCE_COUNT
+// util/leader_trie.sh reads the keys from the start of every entry
+_Static_assert(offsetof(leader_seq_t, keys) == 0, "leader_seq_t must start with its keys");
+
+#ifdef LEADER_TRIE_ENABLE
+// Trie node of the keys typed so far
+static uint16_t leader_node = 0;
+#else
+// Sequences that still match what has been typed so far
+static uint8_t leader_candidates[(LEADER_SEQUENCE_COUNT + 7) / 8];
+#endif
+// Sequence typed completely, waiting only because a longer one shares it
+static int16_t leader_match = -1;
+
+static void leader_finish(void) {
+  // user code may send and wait, as outside of a batch
+  uint8_t batch = report_batch_pause();
+  leading = false;
+  if (leader_match >= 0) {
+    void (*fn)(void);
+    memcpy_P(&fn, &leader_sequences[leader_match].fn, sizeof(fn));
+    leader_match = -1;
+    if (fn)
+      fn();
+  }
+  leader_end();
+  report_batch_resume(batch);
+}
+
+static void leader_reset(void) {
+#ifdef LEADER_TRIE_ENABLE
+  leader_node = 0;
+#else
+  for (uint8_t i = 0; i < sizeof(leader_candidates); i++) {
+    leader_candidates[i] = 0xFF;
+  }
+#endif
+  leader_match = -1;
+}
+
+#ifdef LEADER_TRIE_ENABLE
+static void leader_narrow(uint16_t keycode) {
+  uint16_t node = pgm_read_word(&leader_trie[leader_node].child);
+  while (node != LEADER_TRIE_NONE && pgm_read_word(&leader_trie[node].keycode) != keycode) {
+    node = pgm_read_word(&leader_trie[node].sibling);
+  }
+  if (node == LEADER_TRIE_NONE) {
+    leader_match = -1;
+    leader_finish();
+    return;
+  }
+
+  leader_node = node;
+  leader_match = (int16_t)pgm_read_word(&leader_trie[node].seq);
+  if (pgm_read_word(&leader_trie[node].child) == LEADER_TRIE_NONE) {
+    // nothing longer to wait for
+    leader_finish();
+  }
+}
+#else
+static void leader_narrow(uint16_t keycode) {
+  uint8_t depth = leader_sequence_size - 1;
+  bool longer = false;
+
+  leader_match = -1;
+  for (uint16_t i = 0; i < LEADER_SEQUENCE_COUNT; i++) {
+    uint8_t bit = 1 << (i % 8);
+    if (!(leader_candidates[i / 8] & bit))
+      continue;
+    if (pgm_read_word(&leader_sequences[i].keys[depth]) != keycode) {
+      leader_candidates[i / 8] &= ~bit;
+    } else if (depth + 1 == LEADER_MAX_LENGTH || !pgm_read_word(&leader_sequences[i].keys[depth + 1])) {
+      if (leader_match < 0)
+        leader_match = i;
+    } else {
+      longer = true;
+    }
+  }
+
+  if (!longer) {
+    // either nothing matches or there is nothing left to wait for
+    leader_finish();
+  }
+}
+#endif
+#endif
+
 bool process_leader(uint16_t keycode, keyrecord_t *record) {
   // Leader key set-up
   if (record->event.pressed) {
     if (!leading && keycode == KC_LEAD) {
+      uint8_t batch = report_batch_pause();
       leader_start();
+      report_batch_resume(batch);
       leading = true;
       leader_time = timer_read();
       leader_sequence_size = 0;
@@ -26,13 +116,29 @@ bool process_leader(uint16_t keycode, keyrecord_t *record) {
       leader_sequence[2] = 0;
       leader_sequence[3] = 0;
       leader_sequence[4] = 0;
+#ifdef LEADER_SEQUENCE_COUNT
+      leader_reset();
+#endif
       return false;
     }
     if (leading && timer_elapsed(leader_time) < LEADER_TIMEOUT) {
-      leader_sequence[leader_sequence_size] = keycode;
-      leader_sequence_size++;
+      if (leader_sequence_size < LEADER_MAX_LENGTH) {
+        leader_sequence[leader_sequence_size] = keycode;
+        leader_sequence_size++;
+#ifdef LEADER_SEQUENCE_COUNT
+        leader_narrow(keycode);
+#endif
+      }
       return false;
     }
   }
   return true;
-}
\ No newline at end of file
+}
+
+void matrix_scan_leader(void) {
+#ifdef LEADER_SEQUENCE_COUNT
+  if (leading && timer_elapsed(leader_time) > LEADER_TIMEOUT) {
+    leader_finish();
+  }
+#endif
+}
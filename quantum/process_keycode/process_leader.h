@@ -4,6 +4,7 @@
 #include "quantum.h"
 
 bool process_leader(uint16_t keycode, keyrecord_t *record);
+void matrix_scan_leader(void);
 
 void leader_start(void);
 void leader_end(void);
@@ -11,6 +12,53 @@ void leader_end(void);
 #ifndef LEADER_TIMEOUT
   #define LEADER_TIMEOUT 200
 #endif
+
+#define LEADER_MAX_LENGTH 5
+
+/* Sequence table
+ *
+ * Instead of matching in matrix_scan_user(), sequences can be declared in a
+ * PROGMEM table, with LEADER_SEQUENCE_COUNT defined in config.h:
+ *
+ *   const leader_seq_t PROGMEM leader_sequences[LEADER_SEQUENCE_COUNT] = {
+ *     LEADER_SEQ(save_file, KC_F, KC_S),
+ *     LEADER_SEQ(sudo,      KC_S, KC_U),
+ *   };
+ *
+ * Each key narrows the set of sequences still possible. A sequence runs as
+ * soon as it is the only one left, or when LEADER_TIMEOUT expires if it is
+ * the prefix of a longer one.
+ *
+ * By default every key checks each sequence still possible. With
+ * LEADER_TRIE_ENABLE = yes in rules.mk, util/leader_trie.sh turns the
+ * compiled table into a trie at build time, and a key only looks at the
+ * keys that can follow the ones typed so far.
+ */
+typedef struct {
+  uint16_t keys[LEADER_MAX_LENGTH];
+  void (*fn)(void);
+} leader_seq_t;
+
+#define LEADER_SEQ(func, ...) { .keys = { __VA_ARGS__ }, .fn = func }
+
+#ifdef LEADER_SEQUENCE_COUNT
+  extern const leader_seq_t leader_sequences[LEADER_SEQUENCE_COUNT];
+#endif
+
+#ifdef LEADER_TRIE_ENABLE
+#define LEADER_TRIE_NONE 0xFFFF
+
+// Node 0 stands for the leader key itself
+typedef struct {
+  uint16_t keycode;
+  uint16_t child;     // first node one key further, or LEADER_TRIE_NONE
+  uint16_t sibling;   // next node after the same keys, or LEADER_TRIE_NONE
+  int16_t seq;        // index of the sequence ending here, or -1
+} leader_node_t;
+
+extern const leader_node_t leader_trie[];
+#endif
+
 #define SEQ_ONE_KEY(key) if (leader_sequence[0] == (key) && leader_sequence[1] == 0 && leader_sequence[2] == 0 && leader_sequence[3] == 0 && leader_sequence[4] == 0)
 #define SEQ_TWO_KEYS(key1, key2) if (leader_sequence[0] == (key1) && leader_sequence[1] == (key2) && leader_sequence[2] == 0 && leader_sequence[3] == 0 && leader_sequence[4] == 0)
 #define SEQ_THREE_KEYS(key1, key2, key3) if (leader_sequence[0] == (key1) && leader_sequence[1] == (key2) && leader_sequence[2] == (key3) && leader_sequence[3] == 0 && leader_sequence[4] == 0)
@@ -20,4 +68,4 @@ void leader_end(void);
 #define LEADER_EXTERNS() extern bool leading; extern uint16_t leader_time; extern uint16_t leader_sequence[5]; extern uint8_t leader_sequence_size
 #define LEADER_DICTIONARY() if (leading && timer_elapsed(leader_time) > LEADER_TIMEOUT)
 
-#endif
\ No newline at end of file
+#endif
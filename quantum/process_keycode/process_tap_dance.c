@@ -1,9 +1,6 @@
 #include "quantum.h"
 #include "action_tapping.h"
 
-static uint16_t last_td;
-static int8_t highest_td = -1;
-
 void qk_tap_dance_pair_finished (qk_tap_dance_state_t *state, void *user_data) {
   qk_tap_dance_pair_t *pair = (qk_tap_dance_pair_t *)user_data;
 
@@ -29,7 +26,9 @@ static inline void _process_tap_dance_action_fn (qk_tap_dance_state_t *state,
                                                  qk_tap_dance_user_fn_t fn)
 {
   if (fn) {
+    uint8_t batch = report_batch_pause();
     fn(state, user_data);
+    report_batch_resume(batch);
   }
 }
 
@@ -51,86 +50,64 @@ static inline void process_tap_dance_action_on_reset (qk_tap_dance_action_t *act
   _process_tap_dance_action_fn (&action->state, action->user_data, action->fn.on_reset);
 }
 
+static inline qk_tap_dance_action_t *tap_dance_action (qk_tap_dance_state_t *state)
+{
+  return &tap_dance_actions[state->keycode - QK_TAP_DANCE];
+}
+
+// another key was pressed: the dance is over
+static void tap_dance_interrupted (qk_tap_dance_state_t *state)
+{
+  process_tap_dance_action_on_dance_finished (tap_dance_action (state));
+  reset_tap_dance (state);
+}
+
+// too many machines: the dance is over, even if its key is still down
+static void tap_dance_evicted (qk_tap_dance_state_t *state)
+{
+  qk_tap_dance_action_t *action = tap_dance_action (state);
+
+  process_tap_dance_action_on_dance_finished (action);
+  process_tap_dance_action_on_reset (action);
+  tap_hold_end (state);
+}
+
+static const tap_hold_kind_t tap_dance_kind = {
+  .term = TAPPING_TERM,
+  .on_interrupt = tap_dance_interrupted,
+  .on_timeout = tap_dance_interrupted,
+  .on_evict = tap_dance_evicted,
+};
+
 bool process_tap_dance(uint16_t keycode, keyrecord_t *record) {
-  uint16_t idx = keycode - QK_TAP_DANCE;
   qk_tap_dance_action_t *action;
 
-  if (last_td && last_td != keycode) {
-    (&tap_dance_actions[last_td - QK_TAP_DANCE])->state.interrupted = true;
-  }
-
   switch(keycode) {
   case QK_TAP_DANCE ... QK_TAP_DANCE_MAX:
-    if ((int16_t)idx > highest_td)
-      highest_td = idx;
-    action = &tap_dance_actions[idx];
+    action = &tap_dance_actions[keycode - QK_TAP_DANCE];
 
-    action->state.pressed = record->event.pressed;
     if (record->event.pressed) {
       action->state.keycode = keycode;
-      action->state.count++;
-      action->state.timer = timer_read();
-      process_tap_dance_action_on_each_tap (action);
-
-      if (last_td && last_td != keycode) {
-        qk_tap_dance_action_t *paction = &tap_dance_actions[last_td - QK_TAP_DANCE];
-        paction->state.interrupted = true;
-        process_tap_dance_action_on_dance_finished (paction);
-        reset_tap_dance (&paction->state);
-      }
-
-      last_td = keycode;
+      if (tap_hold_press (&action->state, &tap_dance_kind))
+        process_tap_dance_action_on_each_tap (action);
+    } else {
+      tap_hold_release (&action->state);
     }
-
     break;
 
   default:
-    if (!record->event.pressed)
-      return true;
-
-    if (highest_td == -1)
-      return true;
-
-    for (int i = 0; i <= highest_td; i++) {
-      action = &tap_dance_actions[i];
-      if (action->state.count == 0)
-        continue;
-      action->state.interrupted = true;
-      process_tap_dance_action_on_dance_finished (action);
-      reset_tap_dance (&action->state);
-    }
+    // other keys interrupt dances in process_tap_hold()
     break;
   }
 
   return true;
 }
 
-void matrix_scan_tap_dance () {
-  if (highest_td == -1)
-    return;
-
-  for (int i = 0; i <= highest_td; i++) {
-    qk_tap_dance_action_t *action = &tap_dance_actions[i];
-
-    if (action->state.count && timer_elapsed (action->state.timer) > TAPPING_TERM) {
-      process_tap_dance_action_on_dance_finished (action);
-      reset_tap_dance (&action->state);
-    }
-  }
-}
-
 void reset_tap_dance (qk_tap_dance_state_t *state) {
-  qk_tap_dance_action_t *action;
-
   if (state->pressed)
     return;
 
-  action = &tap_dance_actions[state->keycode - QK_TAP_DANCE];
-
-  process_tap_dance_action_on_reset (action);
+  process_tap_dance_action_on_reset (tap_dance_action (state));
 
-  state->count = 0;
-  state->interrupted = false;
-  state->finished = false;
-  last_td = 0;
+  tap_hold_end (state);
 }
@@ -5,16 +5,9 @@
 
 #include <stdbool.h>
 #include <inttypes.h>
+#include "tap_hold.h"
 
-typedef struct
-{
-  uint8_t count;
-  uint16_t keycode;
-  uint16_t timer;
-  bool interrupted;
-  bool pressed;
-  bool finished;
-} qk_tap_dance_state_t;
+typedef tap_hold_t qk_tap_dance_state_t;
 
 #define TD(n) (QK_TAP_DANCE + n)
 
@@ -57,7 +50,6 @@ extern qk_tap_dance_action_t tap_dance_actions[];
 /* To be used internally */
 
 bool process_tap_dance(uint16_t keycode, keyrecord_t *record);
-void matrix_scan_tap_dance (void);
 void reset_tap_dance (qk_tap_dance_state_t *state);
 
 void qk_tap_dance_pair_finished (qk_tap_dance_state_t *state, void *user_data);
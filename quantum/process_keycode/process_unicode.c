@@ -48,6 +48,7 @@ void unicode_input_start (void) {
     register_code(KC_U);
     unregister_code(KC_U);
   }
+  report_batch_flush();
   wait_ms(UNICODE_TYPE_DELAY);
 }
 
@@ -73,12 +74,220 @@ void register_hex(uint16_t hex) {
   }
 }
 
+#ifdef UNICODE_ASYNC_ENABLE
+/* Unicode output queue
+ *
+ * Each queued entry is either a code point or, with UC_QUEUE_TAP set, a
+ * plain key tap. UC_QUEUE_START and UC_QUEUE_FINISH stand for the input
+ * sequences alone, around taps that need them. The entry at the head of the queue is turned into a short
+ * script of key operations for the current input_mode, and unicode_task()
+ * plays that script back one report at a time, so nothing in here blocks.
+ */
+#define UC_QUEUE_TAP    0x80000000UL
+#define UC_QUEUE_START  0x40000000UL
+#define UC_QUEUE_FINISH 0x20000000UL
+#define UC_SCRIPT_MAX 16
+
+enum {
+  UC_OP_PRESS,
+  UC_OP_RELEASE,
+  UC_OP_TAP,
+  UC_OP_WAIT,
+};
+
+typedef struct {
+  uint8_t op;
+  uint16_t keycode;
+} uc_step_t;
+
+static uint32_t uc_queue[UNICODE_QUEUE_SIZE];
+static uint8_t uc_queue_head = 0;
+static uint8_t uc_queue_count = 0;
+
+static uc_step_t uc_script[UC_SCRIPT_MAX];
+static uint8_t uc_script_len = 0;
+static uint8_t uc_script_pos = 0;
+static bool uc_tap_pressed = false;
+
+static uint16_t uc_timer = 0;
+static uint8_t uc_delay = 0;
+
+static void uc_push(uint8_t op, uint16_t keycode) {
+  if (uc_script_len < UC_SCRIPT_MAX) {
+    uc_script[uc_script_len].op = op;
+    uc_script[uc_script_len].keycode = keycode;
+    uc_script_len++;
+  }
+}
+
+static void uc_encode_start(void) {
+  switch(input_mode) {
+  case UC_OSX:
+    uc_push(UC_OP_PRESS, KC_LALT);
+    break;
+  case UC_LNX:
+    uc_push(UC_OP_PRESS, KC_LCTL);
+    uc_push(UC_OP_PRESS, KC_LSFT);
+    uc_push(UC_OP_TAP, KC_U);
+    uc_push(UC_OP_RELEASE, KC_LSFT);
+    uc_push(UC_OP_RELEASE, KC_LCTL);
+    break;
+  case UC_WIN:
+    uc_push(UC_OP_PRESS, KC_LALT);
+    uc_push(UC_OP_TAP, KC_PPLS);
+    break;
+  case UC_WINC:
+    uc_push(UC_OP_TAP, KC_RALT);
+    uc_push(UC_OP_TAP, KC_U);
+    break;
+  }
+  uc_push(UC_OP_WAIT, 0);
+}
+
+static void uc_encode_finish(void) {
+  switch(input_mode) {
+  case UC_OSX:
+  case UC_WIN:
+    uc_push(UC_OP_RELEASE, KC_LALT);
+    break;
+  case UC_LNX:
+    uc_push(UC_OP_TAP, KC_SPC);
+    break;
+  }
+}
+
+static void uc_encode(uint32_t code) {
+  uc_script_len = 0;
+  uc_script_pos = 0;
+
+  if (code & UC_QUEUE_TAP) {
+    uc_push(UC_OP_TAP, code & 0xFFFF);
+    return;
+  }
+  if (code & UC_QUEUE_START) {
+    uc_encode_start();
+    return;
+  }
+  if (code & UC_QUEUE_FINISH) {
+    uc_encode_finish();
+    return;
+  }
+
+  uc_encode_start();
+  // at least four digits, like register_hex()
+  uint8_t digits = 4;
+  while (digits < 8 && (code >> (digits * 4))) {
+    digits++;
+  }
+  while (digits--) {
+    uc_push(UC_OP_TAP, hex_to_keycode((code >> (digits * 4)) & 0xF));
+  }
+  uc_encode_finish();
+}
+
+// false if the queue was full and had to be typed out first
+static bool uc_enqueue(uint32_t entry) {
+  bool queued = true;
+  if (uc_queue_count == UNICODE_QUEUE_SIZE) {
+    // out of room, make some the slow way
+    unicode_queue_wait();
+    queued = false;
+  }
+  uc_queue[(uc_queue_head + uc_queue_count) % UNICODE_QUEUE_SIZE] = entry;
+  uc_queue_count++;
+  return queued;
+}
+
+bool unicode_queue_code(uint32_t code) {
+  return uc_enqueue(code & ~(UC_QUEUE_TAP | UC_QUEUE_START | UC_QUEUE_FINISH));
+}
+
+bool unicode_queue_tap(uint16_t keycode) {
+  return uc_enqueue(UC_QUEUE_TAP | keycode);
+}
+
+bool unicode_queue_busy(void) {
+  return uc_queue_count || uc_script_pos < uc_script_len;
+}
+
+/* Plays back one step of the current script, one report at most. */
+static void unicode_step(void) {
+  if (uc_script_pos >= uc_script_len) {
+    if (!uc_queue_count) {
+      return;
+    }
+    uc_encode(uc_queue[uc_queue_head]);
+    uc_queue_head = (uc_queue_head + 1) % UNICODE_QUEUE_SIZE;
+    uc_queue_count--;
+    if (!uc_script_len) {
+      // an input sequence with nothing to type in this mode
+      return;
+    }
+  }
+
+  uc_step_t *step = &uc_script[uc_script_pos];
+  switch (step->op) {
+  case UC_OP_PRESS:
+    register_code16(step->keycode);
+    uc_script_pos++;
+    break;
+  case UC_OP_RELEASE:
+    unregister_code16(step->keycode);
+    uc_script_pos++;
+    break;
+  case UC_OP_TAP:
+    if (!uc_tap_pressed) {
+      register_code16(step->keycode);
+      uc_tap_pressed = true;
+    } else {
+      unregister_code16(step->keycode);
+      uc_tap_pressed = false;
+      uc_script_pos++;
+    }
+    break;
+  case UC_OP_WAIT:
+    uc_delay = UNICODE_TYPE_DELAY;
+    uc_script_pos++;
+    break;
+  }
+}
+
+void unicode_task(void) {
+  if (!unicode_queue_busy()) {
+    return;
+  }
+  if (timer_elapsed(uc_timer) < uc_delay) {
+    return;
+  }
+  uc_timer = timer_read();
+  uc_delay = UNICODE_KEY_INTERVAL;
+  unicode_step();
+}
+
+void unicode_queue_wait(void) {
+  while (unicode_queue_busy()) {
+    uc_delay = UNICODE_KEY_INTERVAL;
+    unicode_step();
+    report_batch_flush();
+    for (uint8_t i = 0; i < uc_delay; i++) {
+      wait_ms(1);
+    }
+  }
+  uc_timer = timer_read();
+  uc_delay = 0;
+}
+#endif
+
 bool process_unicode(uint16_t keycode, keyrecord_t *record) {
   if (keycode > QK_UNICODE && record->event.pressed) {
     uint16_t unicode = keycode & 0x7FFF;
+#ifdef UNICODE_ASYNC_ENABLE
+    unicode_queue_code(unicode);
+#else
     unicode_input_start();
     register_hex(unicode);
     unicode_input_finish();
+#endif
   }
   return true;
 }
@@ -118,11 +327,17 @@ bool process_unicode_map(uint16_t keycode, keyrecord_t *record) {
     uint32_t code = pgm_read_dword_far(&map[index]);
     if ((code > 0xFFFF && input_mode == UC_OSX) || (code > 0xFFFFF && input_mode == UC_LNX)) {
       // when character is out of range supported by the OS
+      uint8_t batch = report_batch_pause();
       unicode_map_input_error();
+      report_batch_resume(batch);
     } else {
+#ifdef UNICODE_ASYNC_ENABLE
+      unicode_queue_code(code);
+#else
       unicode_input_start();
       register_hex32(code);
       unicode_input_finish();
+#endif
     }
   }
   return true;
@@ -136,14 +351,20 @@ void qk_ucis_start(void) {
   qk_ucis_state.count = 0;
   qk_ucis_state.in_progress = true;
 
+  uint8_t batch = report_batch_pause();
   qk_ucis_start_user();
+  report_batch_resume(batch);
 }
 
 __attribute__((weak))
 void qk_ucis_start_user(void) {
+#ifdef UNICODE_ASYNC_ENABLE
+  unicode_queue_code(0x2328);
+#else
   unicode_input_start();
   register_hex(0x2328);
   unicode_input_finish();
+#endif
 }
 
 static bool is_uni_seq(char *seq) {
@@ -168,11 +389,39 @@ __attribute__((weak))
 void qk_ucis_symbol_fallback (void) {
   for (uint8_t i = 0; i < qk_ucis_state.count - 1; i++) {
     uint8_t code = qk_ucis_state.codes[i];
+#ifdef UNICODE_ASYNC_ENABLE
+    unicode_queue_tap(code);
+#else
     register_code(code);
     unregister_code(code);
+    report_batch_flush();
     wait_ms(UNICODE_TYPE_DELAY);
+#endif
+  }
+}
+
+#ifdef UNICODE_ASYNC_ENABLE
+static uint32_t ucis_parse_hex(const char *hex) {
+  uint32_t code = 0;
+
+  for (; *hex; hex++) {
+    char c = *hex;
+
+    switch (c) {
+    case '0' ... '9':
+      code = (code << 4) | (c - '0');
+      break;
+    case 'a' ... 'f':
+      code = (code << 4) | (c - 'a' + 0xA);
+      break;
+    case 'A' ... 'F':
+      code = (code << 4) | (c - 'A' + 0xA);
+      break;
+    }
   }
+  return code;
 }
+#endif
 
 void register_ucis(const char *hex) {
   for(int i = 0; hex[i]; i++) {
@@ -197,6 +446,7 @@ void register_ucis(const char *hex) {
     if (kc) {
       register_code (kc);
       unregister_code (kc);
+      report_batch_flush();
       wait_ms (UNICODE_TYPE_DELAY);
     }
   }
@@ -230,11 +480,34 @@ bool process_ucis (uint16_t keycode, keyrecord_t *record) {
   }
 
   if (keycode == KC_ENT || keycode == KC_SPC || keycode == KC_ESC) {
+#ifdef UNICODE_ASYNC_ENABLE
+    for (i = qk_ucis_state.count; i > 0; i--) {
+      unicode_queue_tap(KC_BSPC);
+    }
+
+    qk_ucis_state.in_progress = false;
+    if (keycode == KC_ESC) {
+      return false;
+    }
+
+    for (i = 0; ucis_symbol_table[i].symbol; i++) {
+      if (is_uni_seq (ucis_symbol_table[i].symbol)) {
+        unicode_queue_code(ucis_parse_hex(ucis_symbol_table[i].code + 2));
+        return false;
+      }
+    }
+    // inside an input sequence, like the blocking version
+    uc_enqueue(UC_QUEUE_START);
+    qk_ucis_symbol_fallback();
+    uc_enqueue(UC_QUEUE_FINISH);
+    return false;
+#else
     bool symbol_found = false;
 
     for (i = qk_ucis_state.count; i > 0; i--) {
       register_code (KC_BSPC);
       unregister_code (KC_BSPC);
+      report_batch_flush();
       wait_ms(UNICODE_TYPE_DELAY);
     }
 
@@ -258,6 +531,7 @@ bool process_ucis (uint16_t keycode, keyrecord_t *record) {
 
     qk_ucis_state.in_progress = false;
     return false;
+#endif
   }
   return true;
 }
@@ -19,6 +19,32 @@ void unicode_input_start(void);
 void unicode_input_finish(void);
 void register_hex(uint16_t hex);
 
+/* With UNICODE_ASYNC_ENABLE = yes in rules.mk, UC(), X() and UCIS output is
+ * queued and typed out by unicode_task() from the scan loop instead of
+ * inside the key handler. The queue builds its own input sequences per input_mode, so
+ * overrides of unicode_input_start()/unicode_input_finish() only affect the
+ * synchronous functions above; hex_to_keycode() is honoured by both.
+ */
+#ifdef UNICODE_ASYNC_ENABLE
+// Number of characters that can be waiting to be typed
+#ifndef UNICODE_QUEUE_SIZE
+#define UNICODE_QUEUE_SIZE 8
+#endif
+
+// Minimum time in ms between two reports sent by the queue
+#ifndef UNICODE_KEY_INTERVAL
+#define UNICODE_KEY_INTERVAL 1
+#endif
+
+/* Both return false when the queue was full, so the waiting characters had
+ * to be typed out, blocking, to make room. */
+bool unicode_queue_code(uint32_t code);
+bool unicode_queue_tap(uint16_t keycode);
+bool unicode_queue_busy(void);
+void unicode_queue_wait(void);
+void unicode_task(void);
+#endif
+
 bool process_unicode(uint16_t keycode, keyrecord_t *record);
 
 #ifdef UNICODEMAP_ENABLE
@@ -0,0 +1,148 @@
+#include "gtest/gtest.h"
+#include <vector>
+
+extern "C" {
+#include "process_keycode/process_combo.h"
+}
+
+enum {
+    KC_COMBO_A = 0x10,
+    KC_COMBO_AB,
+    KC_COMBO_LAST,
+    KC_COMBO_MAX,
+};
+
+extern "C" {
+const combo_t key_combos[COMBO_COUNT] = {
+    COMBO(KC_COMBO_A,    KP(0, 0), KP(0, 1)),
+    COMBO(KC_COMBO_AB,   KP(0, 0), KP(0, 1), KP(0, 2)),
+    // the last position of a 16x16 matrix, 0xFF
+    COMBO(KC_COMBO_LAST, KP(15, 14), KP(15, 15)),
+    COMBO(KC_COMBO_MAX,  KP(2, 0), KP(2, 1), KP(2, 2), KP(2, 3)),
+};
+
+static uint16_t now = 1;
+static std::vector<int> sent;
+
+uint16_t timer_read(void) { return now; }
+
+// registered keycodes as they are, unregistered ones negated
+void register_code16(uint16_t code) { sent.push_back(code); }
+void unregister_code16(uint16_t code) { sent.push_back(-code); }
+
+// replayed presses as 1000 + their position
+void process_record(keyrecord_t *record) {
+    sent.push_back(1000 + KP(record->event.key.row, record->event.key.col));
+}
+}
+
+class Combo : public testing::Test {
+public:
+    Combo() {
+        sent.clear();
+        combo_init();
+    }
+    ~Combo() {
+        now += COMBO_TERM * 2;
+        matrix_scan_combo();
+    }
+    bool key(uint8_t row, uint8_t col, bool pressed) {
+        now++;
+        keyrecord_t record = {};
+        record.event.key.col = col;
+        record.event.key.row = row;
+        record.event.pressed = pressed;
+        record.event.time = now;
+        return process_combo(0, &record);
+    }
+    void wait_term() {
+        now += COMBO_TERM + 1;
+        matrix_scan_combo();
+    }
+};
+
+TEST_F(Combo, passes_keys_of_no_combo) {
+    EXPECT_TRUE(key(5, 5, true));
+    EXPECT_TRUE(key(5, 5, false));
+    EXPECT_TRUE(sent.empty());
+}
+
+TEST_F(Combo, fires_when_all_keys_are_down) {
+    EXPECT_FALSE(key(15, 15, true));
+    EXPECT_TRUE(sent.empty());
+    EXPECT_FALSE(key(15, 14, true));
+    EXPECT_EQ(sent, std::vector<int>({KC_COMBO_LAST}));
+    EXPECT_FALSE(key(15, 15, false));
+    EXPECT_FALSE(key(15, 14, false));
+    EXPECT_EQ(sent, std::vector<int>({KC_COMBO_LAST, -KC_COMBO_LAST}));
+}
+
+TEST_F(Combo, takes_up_to_combo_max_keys) {
+    EXPECT_FALSE(key(2, 3, true));
+    EXPECT_FALSE(key(2, 1, true));
+    EXPECT_FALSE(key(2, 0, true));
+    EXPECT_TRUE(sent.empty());
+    EXPECT_FALSE(key(2, 2, true));
+    EXPECT_EQ(sent, std::vector<int>({KC_COMBO_MAX}));
+    for (uint8_t col = 0; col < 4; col++) {
+        EXPECT_FALSE(key(2, col, false));
+    }
+}
+
+TEST_F(Combo, subset_waits_for_the_bigger_combo) {
+    EXPECT_FALSE(key(0, 0, true));
+    EXPECT_FALSE(key(0, 1, true));
+    EXPECT_TRUE(sent.empty());
+    EXPECT_FALSE(key(0, 2, true));
+    EXPECT_EQ(sent, std::vector<int>({KC_COMBO_AB}));
+    EXPECT_FALSE(key(0, 0, false));
+    EXPECT_FALSE(key(0, 1, false));
+    EXPECT_FALSE(key(0, 2, false));
+}
+
+TEST_F(Combo, subset_fires_after_the_term) {
+    EXPECT_FALSE(key(0, 0, true));
+    EXPECT_FALSE(key(0, 1, true));
+    wait_term();
+    EXPECT_EQ(sent, std::vector<int>({KC_COMBO_A}));
+    EXPECT_FALSE(key(0, 1, false));
+    EXPECT_FALSE(key(0, 0, false));
+}
+
+TEST_F(Combo, subset_fires_on_a_release) {
+    EXPECT_FALSE(key(0, 0, true));
+    EXPECT_FALSE(key(0, 1, true));
+    EXPECT_FALSE(key(0, 1, false));
+    EXPECT_EQ(sent, std::vector<int>({KC_COMBO_A, -KC_COMBO_A}));
+    EXPECT_FALSE(key(0, 0, false));
+}
+
+TEST_F(Combo, replays_presses_that_make_no_combo) {
+    EXPECT_FALSE(key(0, 0, true));
+    EXPECT_TRUE(key(5, 5, true));
+    EXPECT_EQ(sent, std::vector<int>({1000 + KP(0, 0)}));
+    EXPECT_TRUE(key(0, 0, false));
+    EXPECT_TRUE(key(5, 5, false));
+}
+
+TEST_F(Combo, replays_presses_after_the_term) {
+    EXPECT_FALSE(key(15, 15, true));
+    wait_term();
+    EXPECT_EQ(sent, std::vector<int>({1000 + KP(15, 15)}));
+    EXPECT_FALSE(key(15, 14, true));
+    wait_term();
+    EXPECT_EQ(sent, std::vector<int>({1000 + KP(15, 15), 1000 + KP(15, 14)}));
+    EXPECT_TRUE(key(15, 15, false));
+    EXPECT_TRUE(key(15, 14, false));
+}
+
+TEST_F(Combo, replays_keys_of_different_combos) {
+    EXPECT_FALSE(key(0, 0, true));
+    EXPECT_FALSE(key(15, 15, true));
+    EXPECT_EQ(sent, std::vector<int>({1000 + KP(0, 0)}));
+    EXPECT_FALSE(key(15, 14, true));
+    EXPECT_EQ(sent, std::vector<int>({1000 + KP(0, 0), KC_COMBO_LAST}));
+    EXPECT_TRUE(key(0, 0, false));
+    EXPECT_FALSE(key(15, 15, false));
+    EXPECT_FALSE(key(15, 14, false));
+}
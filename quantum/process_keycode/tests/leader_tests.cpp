@@ -0,0 +1,106 @@
+#include "gtest/gtest.h"
+#include <vector>
+
+extern "C" {
+#include "process_keycode/process_leader.h"
+}
+
+static uint16_t now = 1;
+static std::vector<int> ran;
+
+extern "C" {
+static void seq_ab(void) { ran.push_back(0); }
+static void seq_a(void) { ran.push_back(1); }
+static void seq_abcde(void) { ran.push_back(2); }
+static void seq_fb(void) { ran.push_back(3); }
+static void seq_ab_again(void) { ran.push_back(4); }
+
+// the same table for the bitmask and the trie walk, see rules.mk
+const leader_seq_t PROGMEM leader_sequences[LEADER_SEQUENCE_COUNT] = {
+    LEADER_SEQ(seq_ab,       0x04, 0x05),
+    // a prefix of the one above
+    LEADER_SEQ(seq_a,        0x04),
+    LEADER_SEQ(seq_abcde,    0x04, 0x05, 0x06, 0x07, 0x08),
+    LEADER_SEQ(seq_fb,       0x09, 0x05),
+    // the first of the same sequences wins
+    LEADER_SEQ(seq_ab_again, 0x04, 0x05),
+};
+
+uint16_t timer_read(void) { return now; }
+uint16_t timer_elapsed(uint16_t last) { return now - last; }
+
+uint8_t report_batch_pause(void) { return 0; }
+void report_batch_resume(uint8_t) {}
+
+// leader_end() as -1
+void leader_end(void) { ran.push_back(-1); }
+}
+
+class Leader : public testing::Test {
+public:
+    Leader() {
+        ran.clear();
+    }
+    bool key(uint16_t keycode) {
+        now++;
+        keyrecord_t record = {};
+        record.event.pressed = true;
+        record.event.time = now;
+        return process_leader(keycode, &record);
+    }
+    void type(std::vector<uint16_t> keys) {
+        EXPECT_FALSE(key(KC_LEAD));
+        for (uint16_t k : keys) {
+            EXPECT_FALSE(key(k));
+        }
+    }
+    void wait_timeout() {
+        now += LEADER_TIMEOUT + 1;
+        matrix_scan_leader();
+    }
+};
+
+TEST_F(Leader, runs_a_sequence_with_nothing_longer_at_once) {
+    type({0x09, 0x05});
+    EXPECT_EQ(ran, std::vector<int>({3, -1}));
+    EXPECT_TRUE(key(0x05));
+}
+
+TEST_F(Leader, runs_the_longest_sequence_at_once) {
+    type({0x04, 0x05, 0x06, 0x07, 0x08});
+    EXPECT_EQ(ran, std::vector<int>({2, -1}));
+}
+
+TEST_F(Leader, prefix_waits_for_the_timeout) {
+    type({0x04});
+    EXPECT_TRUE(ran.empty());
+    wait_timeout();
+    EXPECT_EQ(ran, std::vector<int>({1, -1}));
+}
+
+TEST_F(Leader, first_of_duplicates_runs) {
+    type({0x04, 0x05});
+    EXPECT_TRUE(ran.empty());
+    wait_timeout();
+    EXPECT_EQ(ran, std::vector<int>({0, -1}));
+}
+
+TEST_F(Leader, dead_end_key_ends_at_once) {
+    type({0x04, 0x06});
+    EXPECT_EQ(ran, std::vector<int>({-1}));
+    EXPECT_TRUE(key(0x05));
+    wait_timeout();
+    EXPECT_EQ(ran, std::vector<int>({-1}));
+}
+
+TEST_F(Leader, unknown_first_key_ends_at_once) {
+    type({0x07});
+    EXPECT_EQ(ran, std::vector<int>({-1}));
+}
+
+TEST_F(Leader, incomplete_sequence_runs_nothing) {
+    type({0x04, 0x05, 0x06});
+    EXPECT_TRUE(ran.empty());
+    wait_timeout();
+    EXPECT_EQ(ran, std::vector<int>({-1}));
+}
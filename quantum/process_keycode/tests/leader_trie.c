@@ -0,0 +1,20 @@
+/* Generated from the keymap by util/leader_trie.sh, do not edit */
+#include "quantum.h"
+
+#if LEADER_SEQUENCE_COUNT != 5 || LEADER_MAX_LENGTH != 5
+#error "leader trie was generated for a different table"
+#endif
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "leader trie was read as little endian keycodes"
+#endif
+
+const leader_node_t PROGMEM leader_trie[] = {
+  { 0x0000, 0x0001, 0xFFFF, -1 },
+  { 0x0004, 0x0002, 0x0006, 1 },
+  { 0x0005, 0x0003, 0xFFFF, 0 },
+  { 0x0006, 0x0004, 0xFFFF, -1 },
+  { 0x0007, 0x0005, 0xFFFF, -1 },
+  { 0x0008, 0xFFFF, 0xFFFF, 2 },
+  { 0x0009, 0x0007, 0xFFFF, -1 },
+  { 0x0005, 0xFFFF, 0xFFFF, 3 },
+};
@@ -0,0 +1,31 @@
+#ifndef QUANTUM_H
+#define QUANTUM_H
+
+/* Just as much of quantum.h as the tested process_*.c need, to test them
+ * natively */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "matrix.h"
+#include "action.h"
+#include "action_util.h"
+#include "timer.h"
+#include "progmem.h"
+
+// any keycode the tests don't use otherwise
+#define KC_LEAD 0x7010
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void register_code16(uint16_t code);
+void unregister_code16(uint16_t code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#include "process_keycode/process_leader.h"
+
+#endif
@@ -0,0 +1,26 @@
+process_combo_SRC := \
+	$(QUANTUM_PATH)/process_keycode/tests/combo_tests.cpp \
+	$(QUANTUM_PATH)/process_keycode/process_combo.c
+process_combo_INC := \
+	$(QUANTUM_PATH)/process_keycode/tests
+process_combo_DEFS := \
+	-DMATRIX_ROWS=16 -DMATRIX_COLS=16 -DCOMBO_COUNT=4
+
+process_leader_SRC := \
+	$(QUANTUM_PATH)/process_keycode/tests/leader_tests.cpp \
+	$(QUANTUM_PATH)/process_keycode/process_leader.c
+process_leader_INC := \
+	$(QUANTUM_PATH)/process_keycode/tests
+process_leader_DEFS := \
+	-DLEADER_SEQUENCE_COUNT=5
+
+# leader_trie.c is util/leader_trie.sh's output for the table in
+# leader_tests.cpp, extracted from a -fno-pic build of it as in
+# build_keyboard.mk. Regenerate it when the table changes.
+process_leader_trie_SRC := \
+	$(process_leader_SRC) \
+	$(QUANTUM_PATH)/process_keycode/tests/leader_trie.c
+process_leader_trie_INC := \
+	$(process_leader_INC)
+process_leader_trie_DEFS := \
+	$(process_leader_DEFS) -DLEADER_TRIE_ENABLE
@@ -0,0 +1,4 @@
+TEST_LIST +=\
+	process_combo\
+	process_leader\
+	process_leader_trie
@@ -58,6 +58,7 @@ bool process_record_user(uint16_t keycode, keyrecord_t *record) {
 
 void reset_keyboard(void) {
   clear_keyboard();
+  report_batch_flush();
 #ifdef AUDIO_ENABLE
   stop_all_notes();
   shutdown_user();
@@ -69,6 +70,7 @@ void reset_keyboard(void) {
   bootloader_jump();
 }
 
+#ifdef SPACE_CADET_ENABLE
 // Shift / paren setup
 
 #ifndef LSPO_KEY
@@ -78,8 +80,62 @@ void reset_keyboard(void) {
   #define RSPC_KEY KC_0
 #endif
 
-static bool shift_interrupted[2] = {0, 0};
-static uint16_t scs_timer = 0;
+static tap_hold_t space_cadet[2] = { { .keycode = KC_LSPO }, { .keycode = KC_RSPC } };
+// dropped from the index: the shift stays, but the tap won't be a paren
+static void space_cadet_evicted(tap_hold_t *th) {
+  th->interrupted = true;
+}
+static const tap_hold_kind_t space_cadet_kind = { .on_evict = space_cadet_evicted };
+#endif
+
+#if MAX_LAYER > 32
+// Layer keys past layer 31, which the action codes can't address
+static void process_high_layer(uint16_t keycode, keyrecord_t *record) {
+  uint8_t layer = keycode & 0xFF;
+  bool pressed = record->event.pressed;
+
+  if (layer >= MAX_LAYER)
+    return;
+
+  switch (keycode & 0xFF00) {
+    case QK_TO:
+      if (pressed)
+        layer_move(layer);
+      break;
+    case QK_MOMENTARY:
+      if (pressed)
+        layer_on(layer);
+      else
+        layer_off(layer);
+      break;
+    case QK_DEF_LAYER:
+      if (!pressed)
+        default_layer_set(LAYER_BIT(layer));
+      break;
+    case QK_TOGGLE_LAYER:
+      if (!pressed)
+        layer_invert(layer);
+      break;
+  #ifndef NO_ACTION_ONESHOT
+    case QK_ONE_SHOT_LAYER:
+      if (pressed) {
+        set_oneshot_layer(layer, ONESHOT_START);
+      } else {
+        clear_oneshot_layer_state(ONESHOT_PRESSED);
+      }
+      break;
+  #endif
+  }
+}
+#endif
+
+// keymap code may wait between register_code() and unregister_code()
+static bool process_record_kb_unbatched(uint16_t keycode, keyrecord_t *record) {
+  uint8_t batch = report_batch_pause();
+  bool ret = process_record_kb(keycode, record);
+  report_batch_resume(batch);
+  return ret;
+}
 
 bool process_record_quantum(keyrecord_t *record) {
 
@@ -112,7 +168,13 @@ bool process_record_quantum(keyrecord_t *record) {
     // }
 
   if (!(
-    process_record_kb(keycode, record) &&
+  #ifdef COMBO_ENABLE
+    process_combo(keycode, record) &&
+  #endif
+  #ifdef TAP_HOLD_ENABLE
+    process_tap_hold(keycode, record) &&
+  #endif
+    process_record_kb_unbatched(keycode, record) &&
   #ifdef MIDI_ENABLE
     process_midi(keycode, record) &&
   #endif
@@ -125,9 +187,6 @@ bool process_record_quantum(keyrecord_t *record) {
   #ifndef DISABLE_LEADER
     process_leader(keycode, record) &&
   #endif
-  #ifndef DISABLE_CHORDING
-    process_chording(keycode, record) &&
-  #endif
   #ifdef UNICODE_ENABLE
     process_unicode(keycode, record) &&
   #endif
@@ -147,6 +206,14 @@ bool process_record_quantum(keyrecord_t *record) {
   // Shift / paren setup
 
   switch(keycode) {
+  #if MAX_LAYER > 32
+    case QK_TO ... QK_ONE_SHOT_LAYER_MAX:
+      if ((keycode & 0xFF) >= 32) {
+        process_high_layer(keycode, record);
+        return false;
+      }
+      break;
+  #endif
     case RESET:
       if (record->event.pressed) {
         reset_keyboard();
@@ -288,56 +355,57 @@ bool process_record_quantum(keyrecord_t *record) {
         return false;
       }
       break;
+#ifdef SPACE_CADET_ENABLE
     case KC_LSPO: {
+      tap_hold_t *th = &space_cadet[0];
       if (record->event.pressed) {
-        shift_interrupted[0] = false;
-        scs_timer = timer_read ();
+        if (!tap_hold_press(th, &space_cadet_kind))
+          space_cadet_evicted(th);
         register_mods(MOD_BIT(KC_LSFT));
       }
       else {
         #ifdef DISABLE_SPACE_CADET_ROLLOVER
           if (get_mods() & MOD_BIT(KC_RSFT)) {
-            shift_interrupted[0] = true;
-            shift_interrupted[1] = true;
+            space_cadet[0].interrupted = true;
+            space_cadet[1].interrupted = true;
           }
         #endif
-        if (!shift_interrupted[0] && timer_elapsed(scs_timer) < TAPPING_TERM) {
+        if (!th->interrupted && tap_hold_elapsed(th) < TAPPING_TERM) {
           register_code(LSPO_KEY);
           unregister_code(LSPO_KEY);
         }
         unregister_mods(MOD_BIT(KC_LSFT));
+        tap_hold_end(th);
       }
       return false;
       // break;
     }
 
     case KC_RSPC: {
+      tap_hold_t *th = &space_cadet[1];
       if (record->event.pressed) {
-        shift_interrupted[1] = false;
-        scs_timer = timer_read ();
+        if (!tap_hold_press(th, &space_cadet_kind))
+          space_cadet_evicted(th);
         register_mods(MOD_BIT(KC_RSFT));
       }
       else {
         #ifdef DISABLE_SPACE_CADET_ROLLOVER
           if (get_mods() & MOD_BIT(KC_LSFT)) {
-            shift_interrupted[0] = true;
-            shift_interrupted[1] = true;
+            space_cadet[0].interrupted = true;
+            space_cadet[1].interrupted = true;
           }
         #endif
-        if (!shift_interrupted[1] && timer_elapsed(scs_timer) < TAPPING_TERM) {
+        if (!th->interrupted && tap_hold_elapsed(th) < TAPPING_TERM) {
           register_code(RSPC_KEY);
           unregister_code(RSPC_KEY);
         }
         unregister_mods(MOD_BIT(KC_RSFT));
+        tap_hold_end(th);
       }
       return false;
       // break;
     }
-    default: {
-      shift_interrupted[0] = true;
-      shift_interrupted[1] = true;
-      break;
-    }
+#endif
   }
 
   return process_action_kb(record);
@@ -425,6 +493,7 @@ const uint8_t ascii_to_colemak_keycode_lut[0x80] PROGMEM = {
 
 #endif
 
+#ifndef SEND_STRING_ASYNC_ENABLE
 void send_string(const char *str) {
     while (1) {
         uint8_t keycode;
@@ -444,6 +513,7 @@ void send_string(const char *str) {
         ++str;
     }
 }
+#endif
 
 void update_tri_layer(uint8_t layer1, uint8_t layer2, uint8_t layer3) {
   if (IS_LAYER_ON(layer1) && IS_LAYER_ON(layer2)) {
@@ -491,10 +561,20 @@ void tap_random_base64(void) {
   }
 }
 
+// Defined by dynamic_macro.h when a keymap includes it
+__attribute__ ((weak))
+void dynamic_macro_task(void) {}
+
 void matrix_init_quantum() {
   #ifdef BACKLIGHT_ENABLE
     backlight_init_ports();
   #endif
+  #ifdef COMBO_ENABLE
+    combo_init();
+  #endif
+  #ifdef DYNAMIC_KEYMAP_ENABLE
+    dynamic_keymap_init();
+  #endif
   matrix_init_kb();
 }
 
@@ -503,9 +583,27 @@ void matrix_scan_quantum() {
     matrix_scan_music();
   #endif
 
-  #ifdef TAP_DANCE_ENABLE
-    matrix_scan_tap_dance();
+  #ifdef TAP_HOLD_ENABLE
+    matrix_scan_tap_hold();
+  #endif
+
+  #ifdef COMBO_ENABLE
+    matrix_scan_combo();
+  #endif
+
+  #ifndef DISABLE_LEADER
+    matrix_scan_leader();
   #endif
+
+  #ifdef SEND_STRING_ASYNC_ENABLE
+    send_string_task();
+  #endif
+
+  #if defined(UNICODE_ENABLE) && defined(UNICODE_ASYNC_ENABLE)
+    unicode_task();
+  #endif
+
+  dynamic_macro_task();
   matrix_scan_kb();
 }
 
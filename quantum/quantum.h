@@ -28,10 +28,10 @@
 #include "print.h"
 
 
-extern uint32_t default_layer_state;
+extern layer_state_t default_layer_state;
 
 #ifndef NO_ACTION_LAYER
-	extern uint32_t layer_state;
+	extern layer_state_t layer_state;
 #endif
 
 #ifdef MIDI_ENABLE
@@ -48,15 +48,15 @@ extern uint32_t default_layer_state;
 	#include "process_leader.h"
 #endif
 
-#define DISABLE_CHORDING
-#ifndef DISABLE_CHORDING
-	#include "process_chording.h"
+#ifdef COMBO_ENABLE
+	#include "process_combo.h"
 #endif
 
 #ifdef UNICODE_ENABLE
 	#include "process_unicode.h"
 #endif
 
+#include "tap_hold.h"
 #include "process_tap_dance.h"
 
 #ifdef PRINTING_ENABLE
@@ -66,13 +66,21 @@ extern uint32_t default_layer_state;
 #define SEND_STRING(str) send_string(PSTR(str))
 void send_string(const char *str);
 
+#ifdef SEND_STRING_ASYNC_ENABLE
+	#include "send_string.h"
+#endif
+
+#ifdef DYNAMIC_KEYMAP_ENABLE
+	#include "dynamic_keymap.h"
+#endif
+
 // For tri-layer
 void update_tri_layer(uint8_t layer1, uint8_t layer2, uint8_t layer3);
 
 void tap_random_base64(void);
 
-#define IS_LAYER_ON(layer)  (layer_state & (1UL << (layer)))
-#define IS_LAYER_OFF(layer) (~layer_state & (1UL << (layer)))
+#define IS_LAYER_ON(layer)  (layer_state & LAYER_BIT(layer))
+#define IS_LAYER_OFF(layer) (~layer_state & LAYER_BIT(layer))
 
 void matrix_init_kb(void);
 void matrix_scan_kb(void);
@@ -0,0 +1,257 @@
+#include "send_string.h"
+
+// boot protocol reports only ever carry six keys
+#define SS_MAX_KEYS 6
+
+extern const bool ascii_to_qwerty_shift_lut[0x80];
+extern const uint8_t ascii_to_qwerty_keycode_lut[0x80];
+
+typedef struct {
+  uint8_t keys;
+  uint8_t interval;
+  bool overlap;
+} ss_profile_t;
+
+static const ss_profile_t PROGMEM ss_profiles[] = {
+  [SS_HOST_SAFE] = { 1, 10, false },
+  [SS_HOST_LNX]  = { SS_MAX_KEYS, 1, true },
+  [SS_HOST_WIN]  = { SS_MAX_KEYS, 2, true },
+  [SS_HOST_OSX]  = { 1, 4, true },
+};
+
+static ss_profile_t profile = { 1, 10, false };
+static bool profile_loaded = false;
+
+static const char *queue[SEND_STRING_QUEUE_SIZE];
+static uint8_t queue_head = 0;
+static uint8_t queue_count = 0;
+
+static const char *cursor = NULL;
+
+// keys and shift the engine added to the report, and only those
+static uint8_t held[SS_MAX_KEYS];
+static uint8_t held_count = 0;
+static uint8_t held_mods = 0;
+
+static uint16_t last_report = 0;
+
+static void load_default_profile(void) {
+  if (!profile_loaded) {
+    send_string_set_host(SEND_STRING_HOST);
+  }
+}
+
+void send_string_set_host(uint8_t host) {
+  if (host >= sizeof(ss_profiles) / sizeof(ss_profiles[0])) {
+    host = SS_HOST_SAFE;
+  }
+  memcpy_P(&profile, &ss_profiles[host], sizeof(profile));
+  profile_loaded = true;
+}
+
+void send_string_set_rate(uint8_t keys_per_report, uint8_t interval_ms, bool overlap) {
+  if (keys_per_report == 0) {
+    keys_per_report = 1;
+  } else if (keys_per_report > SS_MAX_KEYS) {
+    keys_per_report = SS_MAX_KEYS;
+  }
+  profile.keys = keys_per_report;
+  profile.interval = interval_ms;
+  profile.overlap = overlap;
+  profile_loaded = true;
+}
+
+bool send_string_enqueue_static(const char *str) {
+  if (queue_count == SEND_STRING_QUEUE_SIZE) {
+    return false;
+  }
+  queue[(queue_head + queue_count) % SEND_STRING_QUEUE_SIZE] = str;
+  queue_count++;
+  return true;
+}
+
+bool send_string_busy(void) {
+  return cursor || queue_count || held_count || held_mods;
+}
+
+static bool is_held(uint8_t keycode) {
+  for (uint8_t i = 0; i < held_count; i++) {
+    if (held[i] == keycode) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void release_held(void) {
+  for (uint8_t i = 0; i < held_count; i++) {
+    del_key(held[i]);
+  }
+  held_count = 0;
+}
+
+static void set_held_mods(uint8_t mods) {
+  del_macro_mods(held_mods);
+  add_macro_mods(mods);
+  held_mods = mods;
+}
+
+static bool use_bitmap(void) {
+#ifdef NKRO_ENABLE
+  return keyboard_protocol && keymap_config.nkro;
+#else
+  return false;
+#endif
+}
+
+// Keys in the report that something else pressed, like a key held down
+static bool held_elsewhere(uint8_t keycode) {
+  if (is_held(keycode)) {
+    return false;
+  }
+#ifdef NKRO_ENABLE
+  if (use_bitmap()) {
+    return (keycode >> 3) < KEYBOARD_REPORT_BITS &&
+           (keyboard_report->nkro.bits[keycode >> 3] & (1 << (keycode & 7)));
+  }
+#endif
+  for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+    if (keyboard_report->keys[i] == keycode) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Skip characters that have no key on a QWERTY host
+static void skip_unmapped(void) {
+  while (cursor) {
+    uint8_t ascii_code = pgm_read_byte(cursor);
+    if (!ascii_code) {
+      cursor = NULL;
+    } else if (ascii_code >= 0x80 ||
+               !pgm_read_byte(&ascii_to_qwerty_keycode_lut[ascii_code])) {
+      cursor++;
+    } else {
+      return;
+    }
+  }
+}
+
+/* Emits at most one report that moves the stream forward. */
+static void send_string_step(void) {
+  if (!cursor && queue_count) {
+    cursor = queue[queue_head];
+    queue_head = (queue_head + 1) % SEND_STRING_QUEUE_SIZE;
+    queue_count--;
+  }
+  skip_unmapped();
+
+  if (!cursor) {
+    // end of stream, let go of everything
+    release_held();
+    set_held_mods(0);
+    send_keyboard_report();
+    return;
+  }
+
+  uint8_t ascii_code = pgm_read_byte(cursor);
+  uint8_t mods = pgm_read_byte(&ascii_to_qwerty_shift_lut[ascii_code]) ? MOD_BIT(KC_LSFT) : 0;
+  uint8_t keycode = pgm_read_byte(&ascii_to_qwerty_keycode_lut[ascii_code]);
+
+  if (held_count && (!profile.overlap || mods != held_mods || is_held(keycode))) {
+    // the shift change can ride along with the release
+    release_held();
+    set_held_mods(mods);
+    send_keyboard_report();
+    return;
+  }
+
+  if (mods != held_mods) {
+    // the modifier goes out on its own so the host sees it before the key
+    set_held_mods(mods);
+    send_keyboard_report();
+    return;
+  }
+
+  if (held_elsewhere(keycode)) {
+    // it can't be pressed again without releasing someone else's key
+    cursor++;
+    return;
+  }
+
+  // Look ahead and pack as many following characters as the report allows.
+  // The bitmap report has no ordering, so there the keycodes must increase.
+  uint8_t batch[SS_MAX_KEYS];
+  uint8_t batch_count = 0;
+  bool bitmap = use_bitmap();
+  do {
+    batch[batch_count++] = keycode;
+    cursor++;
+
+    ascii_code = pgm_read_byte(cursor);
+    if (!ascii_code || ascii_code >= 0x80 || batch_count >= profile.keys)
+      break;
+    keycode = pgm_read_byte(&ascii_to_qwerty_keycode_lut[ascii_code]);
+    if (!keycode || is_held(keycode) || held_elsewhere(keycode))
+      break;
+    if ((pgm_read_byte(&ascii_to_qwerty_shift_lut[ascii_code]) ? MOD_BIT(KC_LSFT) : 0) != mods)
+      break;
+    if (bitmap && keycode <= batch[batch_count - 1])
+      break;
+    for (uint8_t i = 0; i < batch_count; i++) {
+      if (batch[i] == keycode) {
+        keycode = 0;
+        break;
+      }
+    }
+  } while (keycode);
+
+  release_held();
+  for (uint8_t i = 0; i < batch_count; i++) {
+    add_key(batch[i]);
+    held[i] = batch[i];
+  }
+  held_count = batch_count;
+  send_keyboard_report();
+}
+
+void send_string_task(void) {
+  if (!send_string_busy()) {
+    return;
+  }
+  load_default_profile();
+  if (timer_elapsed(last_report) < profile.interval) {
+    return;
+  }
+  last_report = timer_read();
+  send_string_step();
+}
+
+void send_string_wait(void) {
+  load_default_profile();
+  while (send_string_busy()) {
+    send_string_step();
+    report_batch_flush();
+    for (uint8_t i = 0; i < profile.interval; i++) {
+      wait_ms(1);
+    }
+  }
+  last_report = timer_read();
+}
+
+void send_string_clear(void) {
+  queue_count = 0;
+  cursor = NULL;
+  release_held();
+  set_held_mods(0);
+  send_keyboard_report();
+}
+
+void send_string(const char *str) {
+  if (!send_string_enqueue_static(str)) {
+    // queue is full, type out what is already waiting
+    send_string_wait();
+    send_string_enqueue_static(str);
+  }
+}
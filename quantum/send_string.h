@@ -0,0 +1,49 @@
+#ifndef SEND_STRING_H
+#define SEND_STRING_H
+
+#include "quantum.h"
+
+/* Streaming SEND_STRING engine
+ *
+ * send_string() only queues the (PROGMEM) string; send_string_task() types
+ * it out from the scan loop, one report per tick. Consecutive characters
+ * that share the same shift state and map to distinct keys are packed into
+ * a single report and released together, and a key is never carried over
+ * into the next report, so the host always sees a fresh press. Only the
+ * keys the engine pressed are released; a character whose key is held down
+ * on the keyboard can't be pressed again and is skipped.
+ *
+ * How aggressive the packing is depends on the host. Pick a profile with
+ * send_string_set_host() (or SEND_STRING_HOST in config.h), or set the
+ * numbers yourself with send_string_set_rate().
+ */
+
+#define SS_HOST_SAFE 0  // one key per report, explicit release, 10ms per report
+#define SS_HOST_LNX  1  // six keys per report, back-to-back reports, 1ms
+#define SS_HOST_WIN  2  // six keys per report, back-to-back reports, 2ms
+#define SS_HOST_OSX  3  // one key per report, back-to-back reports, 4ms
+
+#ifndef SEND_STRING_HOST
+#define SEND_STRING_HOST SS_HOST_SAFE
+#endif
+
+// Number of strings that can be waiting to be typed
+#ifndef SEND_STRING_QUEUE_SIZE
+#define SEND_STRING_QUEUE_SIZE 4
+#endif
+
+void send_string_set_host(uint8_t host);
+void send_string_set_rate(uint8_t keys_per_report, uint8_t interval_ms, bool overlap);
+
+/* Queues str without copying it, false if the queue is full. The string is
+ * read while it is typed, long after the call returns, so it must have
+ * static storage: a PSTR() or other PROGMEM string, never a buffer on the
+ * stack. send_string() queues the same way, so call send_string_wait()
+ * after it for anything else. */
+bool send_string_enqueue_static(const char *str);
+bool send_string_busy(void);
+void send_string_wait(void);
+void send_string_clear(void);
+void send_string_task(void);
+
+#endif
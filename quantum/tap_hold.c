@@ -0,0 +1,106 @@
+#include "tap_hold.h"
+#include "timer.h"
+
+typedef struct {
+  tap_hold_t *th;
+  const tap_hold_kind_t *kind;
+} tap_hold_active_t;
+
+static tap_hold_active_t active[TAP_HOLD_ACTIVE_MAX];
+static uint8_t active_count = 0;
+
+static int8_t active_find(const tap_hold_t *th) {
+  for (uint8_t i = 0; i < active_count; i++) {
+    if (active[i].th == th)
+      return i;
+  }
+  return -1;
+}
+
+static void active_timeout(uint8_t i) {
+  const tap_hold_kind_t *kind = active[i].kind;
+  if (kind->on_timeout) {
+    kind->on_timeout(active[i].th);
+  }
+}
+
+static void active_remove(uint8_t i) {
+  // keep the order, the oldest machine is evicted first
+  for (active_count--; i < active_count; i++) {
+    active[i] = active[i + 1];
+  }
+}
+
+// Makes room for one machine, false if there is none to evict
+static bool active_evict(void) {
+  for (uint8_t i = 0; i < active_count; i++) {
+    tap_hold_active_t evicted = active[i];
+    if (evicted.kind->on_evict) {
+      active_remove(i);
+      evicted.kind->on_evict(evicted.th);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool tap_hold_press(tap_hold_t *th, const tap_hold_kind_t *kind) {
+  if (active_find(th) < 0) {
+    if (active_count == TAP_HOLD_ACTIVE_MAX && !active_evict())
+      return false;
+    active[active_count++] = (tap_hold_active_t){ th, kind };
+  }
+  th->pressed = true;
+  if (th->count < UINT8_MAX)
+    th->count++;
+  th->timer = timer_read();
+  return true;
+}
+
+void tap_hold_release(tap_hold_t *th) {
+  th->pressed = false;
+}
+
+void tap_hold_end(tap_hold_t *th) {
+  int8_t i = active_find(th);
+  if (i >= 0)
+    active_remove(i);
+  th->count = 0;
+  th->pressed = false;
+  th->interrupted = false;
+  th->finished = false;
+}
+
+uint16_t tap_hold_elapsed(const tap_hold_t *th) {
+  return timer_elapsed(th->timer);
+}
+
+bool process_tap_hold(uint16_t keycode, keyrecord_t *record) {
+  if (!record->event.pressed)
+    return true;
+
+  // handlers may end machines, so walk from the end
+  for (uint8_t i = active_count; i-- > 0;) {
+    if (i >= active_count)
+      continue;
+    tap_hold_t *th = active[i].th;
+    if (th->keycode == keycode)
+      continue;
+    th->interrupted = true;
+    if (active[i].kind->on_interrupt) {
+      active[i].kind->on_interrupt(th);
+    }
+  }
+  return true;
+}
+
+void matrix_scan_tap_hold(void) {
+  for (uint8_t i = active_count; i-- > 0;) {
+    if (i >= active_count)
+      continue;
+    uint16_t term = active[i].kind->term;
+    if (term && tap_hold_elapsed(active[i].th) > term) {
+      active_timeout(i);
+    }
+  }
+}
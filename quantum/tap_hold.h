@@ -0,0 +1,59 @@
+#ifndef TAP_HOLD_H
+#define TAP_HOLD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "action.h"
+
+/* Tap/hold state machines
+ *
+ * Features that care whether a key was tapped, held, interrupted by another
+ * key or timed out (tap dance, space cadet shift) keep one tap_hold_t per
+ * key and drive it through this core. Machines in progress are listed in a
+ * small active index, so a key press interrupts, and the scan times out,
+ * only those instead of every instance a feature has.
+ */
+
+// Machines that can be in progress at once, held space cadet keys included
+#ifndef TAP_HOLD_ACTIVE_MAX
+#define TAP_HOLD_ACTIVE_MAX 4
+#endif
+
+typedef struct {
+  uint16_t keycode;
+  uint16_t timer;
+  uint8_t count;
+  bool pressed     :1;
+  bool interrupted :1;
+  bool finished    :1;
+} tap_hold_t;
+
+/* What a feature's machines do. on_interrupt runs when another key is
+ * pressed, after `interrupted` was set; on_timeout once `term` ms passed
+ * since the last press, if term isn't 0. Either may end the machine.
+ *
+ * on_evict runs when the index is full and the machine, the oldest one
+ * that has on_evict, is dropped from it to make room. It must settle the
+ * machine, which may still be pressed, as it gets no more interrupts or
+ * timeouts. Machines without on_evict are never dropped. */
+typedef struct {
+  uint16_t term;
+  void (*on_interrupt)(tap_hold_t *th);
+  void (*on_timeout)(tap_hold_t *th);
+  void (*on_evict)(tap_hold_t *th);
+} tap_hold_kind_t;
+
+/* Counts a press of th->keycode, starting the machine if it wasn't active.
+ * Returns false, counting nothing, if the index is full and no machine in
+ * it can be evicted. */
+bool tap_hold_press(tap_hold_t *th, const tap_hold_kind_t *kind);
+void tap_hold_release(tap_hold_t *th);
+// Clears the machine and drops it from the active index
+void tap_hold_end(tap_hold_t *th);
+
+uint16_t tap_hold_elapsed(const tap_hold_t *th);
+
+bool process_tap_hold(uint16_t keycode, keyrecord_t *record);
+void matrix_scan_tap_hold(void);
+
+#endif
@@ -0,0 +1,2 @@
+#define QMK_VERSION "42a94f-dirty"
+#define QMK_BUILDDATE "2026-10-19-13:52:21"
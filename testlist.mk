@@ -1,4 +1,7 @@
 include $(ROOT_DIR)/quantum/serial_link/tests/testlist.mk
+include $(ROOT_DIR)/tmk_core/common/tests/testlist.mk
+include $(ROOT_DIR)/quantum/process_keycode/tests/testlist.mk
+include $(ROOT_DIR)/tmk_core/protocol/usb_hid/tests/testlist.mk
 
 define VALIDATE_TEST_LIST
     ifneq ($1,)
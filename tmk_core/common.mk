@@ -15,6 +15,7 @@ TMK_COMMON_SRC +=	$(COMMON_DIR)/host.c \
 	$(COMMON_DIR)/print.c \
 	$(COMMON_DIR)/debug.c \
 	$(COMMON_DIR)/util.c \
+	$(COMMON_DIR)/report.c \
 	$(COMMON_DIR)/eeconfig.c \
 	$(PLATFORM_COMMON_DIR)/suspend.c \
 	$(PLATFORM_COMMON_DIR)/timer.c \
@@ -46,6 +47,11 @@ ifeq ($(strip $(MOUSEKEY_ENABLE)), yes)
     TMK_COMMON_DEFS += -DMOUSE_ENABLE
 endif
 
+# any mouse source, see protocol.mk for the others
+ifneq ($(filter -DMOUSE_ENABLE,$(TMK_COMMON_DEFS) $(OPT_DEFS)),)
+    TMK_COMMON_SRC += $(COMMON_DIR)/pointer.c
+endif
+
 ifeq ($(strip $(EXTRAKEY_ENABLE)), yes)
     TMK_COMMON_DEFS += -DEXTRAKEY_ENABLE
 endif
@@ -49,6 +49,8 @@ void action_exec(keyevent_t event)
 
     keyrecord_t record = { .event = event };
 
+    // everything one event changes goes out as few reports as possible
+    report_batch_begin();
 #ifndef NO_ACTION_TAPPING
     action_tapping_process(record);
 #else
@@ -57,6 +59,7 @@ void action_exec(keyevent_t event)
         dprint("processed: "); debug_record(record); dprintln();
     }
 #endif
+    report_batch_commit();
 }
 
 #ifdef ONEHAND_ENABLE
@@ -104,9 +107,22 @@ void process_record(keyrecord_t *record)
 {
     if (IS_NOEVENT(record->event)) { return; }
 
+#if !defined(NO_ACTION_LAYER) && defined(PREVENT_STUCK_MODIFIERS)
+    if (!disable_action_cache && !record->event.pressed) {
+        update_held_keys(record->event.key, false);
+    }
+#endif
+
     if(!process_record_quantum(record))
         return;
 
+#if !defined(NO_ACTION_LAYER) && defined(PREVENT_STUCK_MODIFIERS)
+    // only presses that reach an action, not those a combo or the keymap took
+    if (!disable_action_cache && record->event.pressed) {
+        update_held_keys(record->event.key, true);
+    }
+#endif
+
     action_t action = store_or_get_action(record->event.pressed, record->event.key);
     dprint("ACTION: "); debug_action(action);
 #ifndef NO_ACTION_LAYER
@@ -311,8 +327,8 @@ void process_action(keyrecord_t *record, action_t action)
                 /* Default Layer Bitwise Operation */
                 if (!event.pressed) {
                     uint8_t shift = action.layer_bitop.part*4;
-                    uint32_t bits = ((uint32_t)action.layer_bitop.bits)<<shift;
-                    uint32_t mask = (action.layer_bitop.xbit) ? ~(((uint32_t)0xf)<<shift) : 0;
+                    layer_state_t bits = ((layer_state_t)action.layer_bitop.bits)<<shift;
+                    layer_state_t mask = (action.layer_bitop.xbit) ? ~(((layer_state_t)0xf)<<shift) : 0;
                     switch (action.layer_bitop.op) {
                         case OP_BIT_AND: default_layer_and(bits | mask); break;
                         case OP_BIT_OR:  default_layer_or(bits | mask);  break;
@@ -325,8 +341,8 @@ void process_action(keyrecord_t *record, action_t action)
                 if (event.pressed ? (action.layer_bitop.on & ON_PRESS) :
                                     (action.layer_bitop.on & ON_RELEASE)) {
                     uint8_t shift = action.layer_bitop.part*4;
-                    uint32_t bits = ((uint32_t)action.layer_bitop.bits)<<shift;
-                    uint32_t mask = (action.layer_bitop.xbit) ? ~(((uint32_t)0xf)<<shift) : 0;
+                    layer_state_t bits = ((layer_state_t)action.layer_bitop.bits)<<shift;
+                    layer_state_t mask = (action.layer_bitop.xbit) ? ~(((layer_state_t)0xf)<<shift) : 0;
                     switch (action.layer_bitop.op) {
                         case OP_BIT_AND: layer_and(bits | mask); break;
                         case OP_BIT_OR:  layer_or(bits | mask);  break;
@@ -439,7 +455,11 @@ void process_action(keyrecord_t *record, action_t action)
         /* Extentions */
 #ifndef NO_ACTION_MACRO
         case ACT_MACRO:
-            action_macro_play(action_get_macro(record, action.func.id, action.func.opt));
+            {
+                uint8_t batch = report_batch_pause();
+                action_macro_play(action_get_macro(record, action.func.id, action.func.opt));
+                report_batch_resume(batch);
+            }
             break;
 #endif
 #ifdef BACKLIGHT_ENABLE
@@ -517,7 +537,11 @@ void process_action(keyrecord_t *record, action_t action)
 #endif
 #ifndef NO_ACTION_FUNCTION
         case ACT_FUNCTION:
-            action_function(record, action.func.id, action.func.opt);
+            {
+                uint8_t batch = report_batch_pause();
+                action_function(record, action.func.id, action.func.opt);
+                report_batch_resume(batch);
+            }
             break;
 #endif
         default:
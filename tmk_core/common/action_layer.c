@@ -2,7 +2,10 @@
 #include "keyboard.h"
 #include "action.h"
 #include "util.h"
+#include "progmem.h"
 #include "action_layer.h"
+#include "matrix.h"
+#include "timer.h"
 
 #ifdef DEBUG_ACTION
 #include "debug.h"
@@ -11,40 +14,86 @@
 #endif
 
 
+#if !defined(NO_ACTION_LAYER) && defined(PREVENT_STUCK_MODIFIERS)
+static void layer_transition(void);
+#endif
+
+#if defined(__arm__)
+uint8_t highest_layer(layer_state_t state)
+{
+    if (!state) return 0;
+#if MAX_LAYER > 32
+    return 63 - __builtin_clzll(state);
+#else
+    return 31 - __builtin_clz(state);
+#endif
+}
+#else
+/* index of the highest bit in a nibble */
+static const uint8_t nibble_msb[16] PROGMEM = {
+    0, 0, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3
+};
+
+uint8_t highest_layer(layer_state_t state)
+{
+    /* find the top non-zero byte, then look its nibbles up */
+    union {
+        layer_state_t state;
+        uint8_t bytes[sizeof(layer_state_t)];
+    } u = { .state = state };
+    for (int8_t i = sizeof(layer_state_t) - 1; i >= 0; i--) {
+        uint8_t byte = u.bytes[i];
+        if (byte) {
+            if (byte >> 4) return i * 8 + 4 + pgm_read_byte(&nibble_msb[byte >> 4]);
+            return i * 8 + pgm_read_byte(&nibble_msb[byte]);
+        }
+    }
+    return 0;
+}
+#endif
+
 /*
  * Default Layer State
  */
-uint32_t default_layer_state = 0;
+layer_state_t default_layer_state = 0;
 
-static void default_layer_state_set(uint32_t state)
+static void default_layer_state_set(layer_state_t state)
 {
+    if (state == default_layer_state) return;
     debug("default_layer_state: ");
     default_layer_debug(); debug(" to ");
     default_layer_state = state;
     default_layer_debug(); debug("\n");
+#if !defined(NO_ACTION_LAYER) && defined(PREVENT_STUCK_MODIFIERS)
+    layer_transition();
+#else
     clear_keyboard_but_mods(); // To avoid stuck keys
+#endif
 }
 
 void default_layer_debug(void)
 {
-    dprintf("%08lX(%u)", default_layer_state, biton32(default_layer_state));
+#if MAX_LAYER > 32
+    dprintf("%08lX", (uint32_t)(default_layer_state >> 32));
+#endif
+    dprintf("%08lX(%u)", (uint32_t)default_layer_state, highest_layer(default_layer_state));
 }
 
-void default_layer_set(uint32_t state)
+void default_layer_set(layer_state_t state)
 {
     default_layer_state_set(state);
 }
 
 #ifndef NO_ACTION_LAYER
-void default_layer_or(uint32_t state)
+void default_layer_or(layer_state_t state)
 {
     default_layer_state_set(default_layer_state | state);
 }
-void default_layer_and(uint32_t state)
+void default_layer_and(layer_state_t state)
 {
     default_layer_state_set(default_layer_state & state);
 }
-void default_layer_xor(uint32_t state)
+void default_layer_xor(layer_state_t state)
 {
     default_layer_state_set(default_layer_state ^ state);
 }
@@ -55,15 +104,20 @@ void default_layer_xor(uint32_t state)
 /*
  * Keymap Layer State
  */
-uint32_t layer_state = 0;
+layer_state_t layer_state = 0;
 
-static void layer_state_set(uint32_t state)
+static void layer_state_set(layer_state_t state)
 {
+    if (state == layer_state) return;
     dprint("layer_state: ");
     layer_debug(); dprint(" to ");
     layer_state = state;
     layer_debug(); dprintln();
+#if !defined(NO_ACTION_LAYER) && defined(PREVENT_STUCK_MODIFIERS)
+    layer_transition();
+#else
     clear_keyboard_but_mods(); // To avoid stuck keys
+#endif
 }
 
 void layer_clear(void)
@@ -73,40 +127,43 @@ void layer_clear(void)
 
 void layer_move(uint8_t layer)
 {
-    layer_state_set(1UL<<layer);
+    layer_state_set(LAYER_BIT(layer));
 }
 
 void layer_on(uint8_t layer)
 {
-    layer_state_set(layer_state | (1UL<<layer));
+    layer_state_set(layer_state | (LAYER_BIT(layer)));
 }
 
 void layer_off(uint8_t layer)
 {
-    layer_state_set(layer_state & ~(1UL<<layer));
+    layer_state_set(layer_state & ~(LAYER_BIT(layer)));
 }
 
 void layer_invert(uint8_t layer)
 {
-    layer_state_set(layer_state ^ (1UL<<layer));
+    layer_state_set(layer_state ^ (LAYER_BIT(layer)));
 }
 
-void layer_or(uint32_t state)
+void layer_or(layer_state_t state)
 {
     layer_state_set(layer_state | state);
 }
-void layer_and(uint32_t state)
+void layer_and(layer_state_t state)
 {
     layer_state_set(layer_state & state);
 }
-void layer_xor(uint32_t state)
+void layer_xor(layer_state_t state)
 {
     layer_state_set(layer_state ^ state);
 }
 
 void layer_debug(void)
 {
-    dprintf("%08lX(%u)", layer_state, biton32(layer_state));
+#if MAX_LAYER > 32
+    dprintf("%08lX", (uint32_t)(layer_state >> 32));
+#endif
+    dprintf("%08lX(%u)", (uint32_t)layer_state, highest_layer(layer_state));
 }
 #endif
 
@@ -143,6 +200,68 @@ uint8_t read_source_layers_cache(keypos_t key)
 
     return layer;
 }
+
+static matrix_row_t held_keys[MATRIX_ROWS];
+/* keys layer_transition() released for good, their own release does nothing */
+static matrix_row_t released_keys[MATRIX_ROWS];
+
+void update_held_keys(keypos_t key, bool pressed)
+{
+    if (pressed) {
+        held_keys[key.row] |= (matrix_row_t)1 << key.col;
+    } else {
+        held_keys[key.row] &= ~((matrix_row_t)1 << key.col);
+    }
+}
+
+/* plain keys and modified keys, the only ones that are safe to swap */
+static bool is_key_action(action_t action)
+{
+    return action.code != ACTION_NO &&
+           (action.kind.id == ACT_LMODS || action.kind.id == ACT_RMODS);
+}
+
+/*
+ * Bring held keys in line with a new layer state instead of clearing the
+ * keyboard. Only keys whose action differs between the layer they were
+ * pressed on and the layer they resolve to now are touched: a plain key is
+ * released and the plain key now under it, if any, is pressed. Layer, tap
+ * and macro keys keep the action they were pressed with.
+ */
+static void layer_transition(void)
+{
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        matrix_row_t held = held_keys[row];
+        for (uint8_t col = 0; held; col++, held >>= 1) {
+            if (!(held & 1)) continue;
+
+            keypos_t key = { .col = col, .row = row };
+            uint8_t from = read_source_layers_cache(key);
+            uint8_t to = layer_switch_get_layer(key);
+            if (from == to) continue;
+
+            action_t before = action_for_key(from, key);
+            action_t after = action_for_key(to, key);
+            if (before.code == after.code) {
+                update_source_layers_cache(key, to);
+                continue;
+            }
+            if (!is_key_action(before)) continue;
+
+            keyrecord_t record = { .event = { .key = key, .pressed = false, .time = (timer_read() | 1) } };
+            dprintf("layer_transition: %u,%u %u -> %u\n", row, col, from, to);
+            process_action(&record, before);
+            if (is_key_action(after)) {
+                record.event.pressed = true;
+                process_action(&record, after);
+                update_source_layers_cache(key, to);
+            } else {
+                update_held_keys(key, false);
+                released_keys[row] |= (matrix_row_t)1 << col;
+            }
+        }
+    }
+}
 #endif
 
 /*
@@ -159,12 +278,18 @@ action_t store_or_get_action(bool pressed, keypos_t key)
     }
 
     uint8_t layer;
+    matrix_row_t bit = (matrix_row_t)1 << key.col;
 
     if (pressed) {
+        released_keys[key.row] &= ~bit;
         layer = layer_switch_get_layer(key);
         update_source_layers_cache(key, layer);
     }
     else {
+        if (released_keys[key.row] & bit) {
+            released_keys[key.row] &= ~bit;
+            return (action_t){ .code = ACTION_NO };
+        }
         layer = read_source_layers_cache(key);
     }
     return action_for_key(layer, key);
@@ -180,20 +305,20 @@ int8_t layer_switch_get_layer(keypos_t key)
     action.code = ACTION_TRANSPARENT;
 
 #ifndef NO_ACTION_LAYER
-    uint32_t layers = layer_state | default_layer_state;
-    /* check top layer first */
-    for (int8_t i = 31; i >= 0; i--) {
-        if (layers & (1UL<<i)) {
-            action = action_for_key(i, key);
-            if (action.code != ACTION_TRANSPARENT) {
-                return i;
-            }
+    layer_state_t layers = layer_state | default_layer_state;
+    /* check top layer first, visiting only the layers that are on */
+    while (layers) {
+        uint8_t i = highest_layer(layers);
+        action = action_for_key(i, key);
+        if (action.code != ACTION_TRANSPARENT) {
+            return i;
         }
+        layers &= ~LAYER_BIT(i);
     }
     /* fall back to layer 0 */
     return 0;
 #else
-    return biton32(default_layer_state);
+    return highest_layer(default_layer_state);
 #endif
 }
 
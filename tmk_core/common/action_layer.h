@@ -22,18 +22,49 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "action.h"
 
 
+/*
+ * Layer state width, chosen in config.h. Narrower states are cheaper to
+ * test and copy on AVR; 32 layers is the default, 64 the most.
+ */
+#if defined(LAYER_STATE_8BIT)
+typedef uint8_t layer_state_t;
+#define MAX_LAYER 8
+#define MAX_LAYER_BITS 3
+#elif defined(LAYER_STATE_16BIT)
+typedef uint16_t layer_state_t;
+#define MAX_LAYER 16
+#define MAX_LAYER_BITS 4
+#elif defined(LAYER_STATE_64BIT)
+typedef uint64_t layer_state_t;
+#define MAX_LAYER 64
+#define MAX_LAYER_BITS 6
+#elif defined(LAYER_STATE_128BIT)
+/* layer_switch_get_layer() and the layer caches hold layers in an int8_t */
+#  error "LAYER_STATE_128BIT is not supported, 64 layers is the most"
+#else
+typedef uint32_t layer_state_t;
+#define MAX_LAYER 32
+#define MAX_LAYER_BITS 5
+#endif
+
+#define LAYER_BIT(layer) ((layer_state_t)1 << (layer))
+
+/* highest layer set in state, 0 if none */
+uint8_t highest_layer(layer_state_t state);
+
+
 /*
  * Default Layer
  */
-extern uint32_t default_layer_state;
+extern layer_state_t default_layer_state;
 void default_layer_debug(void);
-void default_layer_set(uint32_t state);
+void default_layer_set(layer_state_t state);
 
 #ifndef NO_ACTION_LAYER
 /* bitwise operation */
-void default_layer_or(uint32_t state);
-void default_layer_and(uint32_t state);
-void default_layer_xor(uint32_t state);
+void default_layer_or(layer_state_t state);
+void default_layer_and(layer_state_t state);
+void default_layer_xor(layer_state_t state);
 #else
 #define default_layer_or(state)
 #define default_layer_and(state)
@@ -45,7 +76,7 @@ void default_layer_xor(uint32_t state);
  * Keymap Layer
  */
 #ifndef NO_ACTION_LAYER
-extern uint32_t layer_state;
+extern layer_state_t layer_state;
 void layer_debug(void);
 void layer_clear(void);
 void layer_move(uint8_t layer);
@@ -53,9 +84,9 @@ void layer_on(uint8_t layer);
 void layer_off(uint8_t layer);
 void layer_invert(uint8_t layer);
 /* bitwise operation */
-void layer_or(uint32_t state);
-void layer_and(uint32_t state);
-void layer_xor(uint32_t state);
+void layer_or(layer_state_t state);
+void layer_and(layer_state_t state);
+void layer_xor(layer_state_t state);
 #else
 #define layer_state             0
 #define layer_clear()
@@ -73,10 +104,9 @@ void layer_xor(uint32_t state);
 
 /* pressed actions cache */
 #if !defined(NO_ACTION_LAYER) && defined(PREVENT_STUCK_MODIFIERS)
-/* The number of bits needed to represent the layer number: log2(32). */
-#define MAX_LAYER_BITS 5
 void update_source_layers_cache(keypos_t key, uint8_t layer);
 uint8_t read_source_layers_cache(keypos_t key);
+void update_held_keys(keypos_t key, bool pressed);
 #endif
 action_t store_or_get_action(bool pressed, keypos_t key);
 
@@ -60,6 +60,7 @@ void action_macro_play(const macro_t *macro_p)
             case WAIT:
                 MACRO_READ();
                 dprintf("WAIT(%u)\n", macro);
+                report_batch_flush();
                 { uint8_t ms = macro; while (ms--) wait_ms(1); }
                 break;
             case INTERVAL:
@@ -79,6 +80,7 @@ void action_macro_play(const macro_t *macro_p)
                 return;
         }
         // interval
+        report_batch_flush();
         { uint8_t ms = interval; while (ms--) wait_ms(1); }
     }
 }
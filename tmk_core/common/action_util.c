@@ -36,6 +36,13 @@ static uint8_t real_mods = 0;
 static uint8_t weak_mods = 0;
 static uint8_t macro_mods = 0;
 
+/* report batching */
+static uint8_t batch_depth = 0;
+static bool batch_pending = false;      // keyboard_report holds changes not sent yet
+static bool batch_keys_added = false;
+static bool batch_keys_removed = false;
+static uint8_t batch_sent_mods = 0;     // mods of the last report the host got
+
 #ifdef USB_6KRO_ENABLE
 #define RO_ADD(a, b) ((a + b) % KEYBOARD_REPORT_KEYS)
 #define RO_SUB(a, b) ((a - b + KEYBOARD_REPORT_KEYS) % KEYBOARD_REPORT_KEYS)
@@ -72,7 +79,11 @@ inline bool has_oneshot_mods_timed_out() {
 *   L => are layer bits
 *   S => oneshot state bits
 */
-static int8_t oneshot_layer_data = 0;
+#if MAX_LAYER > 32
+static uint16_t oneshot_layer_data = 0;
+#else
+static uint8_t oneshot_layer_data = 0;
+#endif
 
 inline uint8_t get_oneshot_layer(void) { return oneshot_layer_data >> 3; }
 inline uint8_t get_oneshot_layer_state(void) { return oneshot_layer_data & 0b111; }
@@ -102,7 +113,7 @@ void reset_oneshot_layer(void) {
 }
 void clear_oneshot_layer_state(oneshot_fullfillment_t state)
 {
-    uint8_t start_state = oneshot_layer_data;
+    uint16_t start_state = oneshot_layer_data;
     oneshot_layer_data &= ~state;
     if (!get_oneshot_layer_state() && start_state != oneshot_layer_data) {
         layer_off(get_oneshot_layer());
@@ -118,9 +129,7 @@ bool is_oneshot_layer_active(void)
 #endif
 
 void send_keyboard_report(void) {
-    keyboard_report->mods  = real_mods;
-    keyboard_report->mods |= weak_mods;
-    keyboard_report->mods |= macro_mods;
+    uint8_t mods = real_mods | weak_mods | macro_mods;
 #ifndef NO_ACTION_ONESHOT
     if (oneshot_mods) {
 #if (defined(ONESHOT_TIMEOUT) && (ONESHOT_TIMEOUT > 0))
@@ -129,19 +138,89 @@ void send_keyboard_report(void) {
             clear_oneshot_mods();
         }
 #endif
-        keyboard_report->mods |= oneshot_mods;
+        mods |= oneshot_mods;
         if (has_anykey()) {
             clear_oneshot_mods();
         }
     }
 
 #endif
+    if (batch_depth) {
+        // a mod going back to what the host has would never be seen,
+        // e.g. a tapped shift or a oneshot mod: send the pending one first
+        if ((keyboard_report->mods ^ batch_sent_mods) & (keyboard_report->mods ^ mods)) {
+            report_batch_flush();
+        }
+        keyboard_report->mods = mods;
+        batch_pending = true;
+        return;
+    }
+    keyboard_report->mods = mods;
     host_keyboard_send(keyboard_report);
 }
 
+/* Between begin and commit, send_keyboard_report() only updates the report
+ * and the changes go to the host together. The pending report is sent early
+ * when coalescing would hide a transition: a key or mod released after being
+ * pressed in the same batch or the other way round, and a key pressed after
+ * a mod change, as some hosts need to see shift before the key. */
+void report_batch_begin(void)
+{
+    if (batch_depth++ == 0) {
+        batch_pending = false;
+        batch_keys_added = false;
+        batch_keys_removed = false;
+        batch_sent_mods = keyboard_report->mods;
+    }
+}
+
+void report_batch_commit(void)
+{
+    if (batch_depth && --batch_depth == 0) {
+        report_batch_flush();
+    }
+}
+
+/* sends the pending report now, for code about to wait or jump away */
+void report_batch_flush(void)
+{
+    if (batch_pending) {
+        host_keyboard_send(keyboard_report);
+        batch_pending = false;
+    }
+    batch_keys_added = false;
+    batch_keys_removed = false;
+    batch_sent_mods = keyboard_report->mods;
+}
+
+/* Keymap code runs unbatched, as it may wait between a press and its release:
+ * what it sends has to reach the host before the wait, not after it. */
+uint8_t report_batch_pause(void)
+{
+    uint8_t depth = batch_depth;
+    report_batch_flush();
+    batch_depth = 0;
+    return depth;
+}
+
+void report_batch_resume(uint8_t depth)
+{
+    batch_depth = depth;
+    batch_pending = false;
+    batch_keys_added = false;
+    batch_keys_removed = false;
+    batch_sent_mods = keyboard_report->mods;
+}
+
 /* key */
 void add_key(uint8_t key)
 {
+    if (batch_depth) {
+        if (batch_keys_removed || keyboard_report->mods != batch_sent_mods) {
+            report_batch_flush();
+        }
+        batch_keys_added = true;
+    }
 #ifdef NKRO_ENABLE
     if (keyboard_protocol && keymap_config.nkro) {
         add_key_bit(key);
@@ -153,6 +232,12 @@ void add_key(uint8_t key)
 
 void del_key(uint8_t key)
 {
+    if (batch_depth) {
+        if (batch_keys_added) {
+            report_batch_flush();
+        }
+        batch_keys_removed = true;
+    }
 #ifdef NKRO_ENABLE
     if (keyboard_protocol && keymap_config.nkro) {
         del_key_bit(key);
@@ -164,6 +249,12 @@ void del_key(uint8_t key)
 
 void clear_keys(void)
 {
+    if (batch_depth) {
+        if (batch_keys_added) {
+            report_batch_flush();
+        }
+        batch_keys_removed = true;
+    }
     // not clear mods
     for (int8_t i = 1; i < KEYBOARD_REPORT_SIZE; i++) {
         keyboard_report->raw[i] = 0;
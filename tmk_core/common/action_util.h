@@ -28,6 +28,13 @@ extern report_keyboard_t *keyboard_report;
 
 void send_keyboard_report(void);
 
+/* report batching */
+void report_batch_begin(void);
+void report_batch_commit(void);
+void report_batch_flush(void);
+uint8_t report_batch_pause(void);
+void report_batch_resume(uint8_t depth);
+
 /* key */
 void add_key(uint8_t key);
 void del_key(uint8_t key);
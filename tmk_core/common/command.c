@@ -55,6 +55,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
     #include "audio.h"
 #endif /* AUDIO_ENABLE */
 
+#ifdef ADAFRUIT_BLE_ENABLE
+    #include "adafruit_ble.h"
+#endif
+
 
 static bool command_common(uint8_t code);
 static void command_common_help(void);
@@ -254,6 +258,10 @@ static void print_status(void)
 #   if USB_COUNT_SOF
     print_val_hex8(usbSofCount);
 #   endif
+#endif
+
+#ifdef ADAFRUIT_BLE_ENABLE
+    adafruit_ble_print_stats();
 #endif
 	return;
 }
@@ -364,6 +372,7 @@ static bool command_common(uint8_t code)
         // jump to bootloader
         case MAGIC_KC(MAGIC_KEY_BOOTLOADER):
             clear_keyboard(); // clear to prevent stuck keys
+            report_batch_flush();
             print("\n\nJumping to bootloader... ");
             #ifdef AUDIO_ENABLE
 	            stop_all_notes();
@@ -580,6 +589,7 @@ static void mousekey_param_print(void)
     print("4: time_to_max: "); pdec(mk_time_to_max); print("\n");
     print("5: wheel_max_speed: "); pdec(mk_wheel_max_speed); print("\n");
     print("6: wheel_time_to_max: "); pdec(mk_wheel_time_to_max); print("\n");
+    print("7: curve: "); print_decs(mk_curve); print("\n");
 #endif /* !NO_PRINT */
 
 }
@@ -631,6 +641,13 @@ static void mousekey_param_inc(uint8_t param, uint8_t inc)
                 mk_wheel_time_to_max = UINT8_MAX;
             PRINT_SET_VAL(mk_wheel_time_to_max);
             break;
+        case 7:
+            if (mk_curve + inc < INT8_MAX)
+                mk_curve += inc;
+            else
+                mk_curve = INT8_MAX;
+            PRINT_SET_VAL(mk_curve);
+            break;
     }
 }
 
@@ -679,6 +696,13 @@ static void mousekey_param_dec(uint8_t param, uint8_t dec)
                 mk_wheel_time_to_max = 0;
             PRINT_SET_VAL(mk_wheel_time_to_max);
             break;
+        case 7:
+            if (mk_curve - dec > -INT8_MAX)
+                mk_curve -= dec;
+            else
+                mk_curve = -INT8_MAX;
+            PRINT_SET_VAL(mk_curve);
+            break;
     }
 }
 
@@ -692,6 +716,7 @@ static void mousekey_console_help(void)
           "4:	time_to_max\n"
           "5:	wheel_max_speed\n"
           "6:	wheel_time_to_max\n"
+          "7:	curve\n"
           "\n"
           "p:	print values\n"
           "d:	set defaults\n"
@@ -700,7 +725,7 @@ static void mousekey_console_help(void)
           "pgup:	+10\n"
           "pgdown:	-10\n"
           "\n"
-          "speed = delta * max_speed * (repeat / time_to_max)\n");
+          "speed = delta * max_speed * curve(time / (time_to_max * interval))\n");
     xprintf("where delta: cursor=%d, wheel=%d\n"
             "See http://en.wikipedia.org/wiki/Mouse_keys\n", MOUSEKEY_MOVE_DELTA,  MOUSEKEY_WHEEL_DELTA);
 }
@@ -731,6 +756,7 @@ static bool mousekey_console(uint8_t code)
         case KC_4:
         case KC_5:
         case KC_6:
+        case KC_7:
             mousekey_param = numkey2num(code);
             break;
         case KC_UP:
@@ -752,6 +778,7 @@ static bool mousekey_console(uint8_t code)
             mk_time_to_max = MOUSEKEY_TIME_TO_MAX;
             mk_wheel_max_speed = MOUSEKEY_WHEEL_MAX_SPEED;
             mk_wheel_time_to_max = MOUSEKEY_WHEEL_TIME_TO_MAX;
+            mk_curve = MOUSEKEY_CURVE;
             print("set default\n");
             break;
         default:
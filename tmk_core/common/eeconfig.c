@@ -43,7 +43,14 @@ uint8_t eeconfig_read_default_layer(void)      { return eeprom_read_byte(EECONFI
 void eeconfig_update_default_layer(uint8_t val) { eeprom_update_byte(EECONFIG_DEFAULT_LAYER, val); }
 
 uint8_t eeconfig_read_keymap(void)      { return eeprom_read_byte(EECONFIG_KEYMAP); }
-void eeconfig_update_keymap(uint8_t val) { eeprom_update_byte(EECONFIG_KEYMAP, val); }
+void eeconfig_update_keymap(uint8_t val)
+{
+    eeprom_update_byte(EECONFIG_KEYMAP, val);
+    keymap_config_changed();
+}
+
+__attribute__ ((weak))
+void keymap_config_changed(void) {}
 
 #ifdef BACKLIGHT_ENABLE
 uint8_t eeconfig_read_backlight(void)      { return eeprom_read_byte(EECONFIG_BACKLIGHT); }
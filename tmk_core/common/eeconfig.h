@@ -68,6 +68,9 @@ void eeconfig_update_default_layer(uint8_t val);
 
 uint8_t eeconfig_read_keymap(void);
 void eeconfig_update_keymap(uint8_t val);
+/* called by eeconfig_update_keymap() and when the keymap config is loaded,
+ * for code that caches something derived from it */
+void keymap_config_changed(void);
 
 #ifdef BACKLIGHT_ENABLE
 uint8_t eeconfig_read_backlight(void);
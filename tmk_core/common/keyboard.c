@@ -47,6 +47,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifdef ADB_MOUSE_ENABLE
 #   include "adb.h"
 #endif
+#ifdef MOUSE_ENABLE
+#   include "pointer.h"
+#endif
 #ifdef RGBLIGHT_ENABLE
 #   include "rgblight.h"
 #endif
@@ -150,7 +153,7 @@ void keyboard_task(void)
                 if (matrix_change & ((matrix_row_t)1<<c)) {
                     action_exec((keyevent_t){
                         .key = (keypos_t){ .row = r, .col = c },
-                        .pressed = (matrix_row & ((matrix_row_t)1<<c)),
+                        .pressed = (matrix_row & ((matrix_row_t)1<<c)) != 0,
                         .time = (timer_read() | 1) /* time should not be 0 */
                     });
                     // record a processed key
@@ -183,6 +186,11 @@ MATRIX_LOOP_END:
     adb_mouse_task();
 #endif
 
+#ifdef MOUSE_ENABLE
+    // one report for all of the above
+    pointer_task();
+#endif
+
 #ifdef SERIAL_LINK_ENABLE
 	serial_link_update();
 #endif
@@ -32,13 +32,19 @@ typedef struct {
     uint8_t row;
 } keypos_t;
 
-/* key event */
+/* key event, packed into 4 bytes
+ * time holds the low 15 bits of timer_read(), compare with KEYEVENT_TIME_DIFF()
+ */
 typedef struct {
     keypos_t key;
-    bool     pressed;
-    uint16_t time;
+    bool     pressed :1;
+    uint16_t time    :15;
 } keyevent_t;
 
+#define KEYEVENT_TIME_MASK          0x7FFF
+#define KEYEVENT_TIME_DIFF(a, b)    ((uint16_t)((a) - (b)) & KEYEVENT_TIME_MASK)
+#define KEYEVENT_ELAPSED(event)     KEYEVENT_TIME_DIFF(timer_read(), (event).time)
+
 /* equivalent test of keypos_t */
 #define KEYEQ(keya, keyb)       ((keya).row == (keyb).row && (keya).col == (keyb).col)
 
@@ -26,6 +26,7 @@ void magic(void)
 
     /* keymap config */
     keymap_config.raw = eeconfig_read_keymap();
+    keymap_config_changed();
 
     uint8_t default_layer = 0;
     default_layer = eeconfig_read_default_layer();
@@ -22,21 +22,36 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "print.h"
 #include "debug.h"
 #include "mousekey.h"
+#include "pointer.h"
 
 
 
 static report_mouse_t mouse_report = {};
-static uint8_t mousekey_repeat =  0;
 static uint8_t mousekey_accel = 0;
 
 static void mousekey_debug(void);
 
 
+/* Motion state. Speeds and positions are Q8.8 fixed point in report units,
+ * so slow motion builds up over several reports instead of being lost. */
+enum { AXIS_X, AXIS_Y, AXIS_V, AXIS_H, AXES };
+
+static int8_t   mousekey_dir[AXES];     // -1, 0 or 1 per axis
+static int16_t  mousekey_rest[AXES];    // motion not reported yet, Q8.8
+static bool     mousekey_repeating = false;
+static uint16_t mousekey_ramp = 0;      // ms spent accelerating, saturates
+
+
 /*
  * Mouse keys  acceleration algorithm
  *  http://en.wikipedia.org/wiki/Mouse_keys
  *
- *  speed = delta * max_speed * (repeat / time_to_max)**((1000+curve)/1000)
+ *  speed = delta * max_speed * curve(time / (time_to_max * interval))
+ *  curve(p) = p - (mk_curve / 127) * p * (1 - p)
+ *
+ * mk_curve 0 ramps linearly, 127 like p^2 (slow start), -127 like 2p - p^2
+ * (fast start). Speed is per interval; motion is integrated over the time
+ * that actually passed between reports.
  */
 /* milliseconds between the initial key press and first repeated motion event (0-2550) */
 uint8_t mk_delay = MOUSEKEY_DELAY/10;
@@ -44,97 +59,172 @@ uint8_t mk_delay = MOUSEKEY_DELAY/10;
 uint8_t mk_interval = MOUSEKEY_INTERVAL;
 /* steady speed (in action_delta units) applied each event (0-255) */
 uint8_t mk_max_speed = MOUSEKEY_MAX_SPEED;
-/* number of events (count) accelerating to steady speed (0-255) */
+/* number of intervals accelerating to steady speed (0-255) */
 uint8_t mk_time_to_max = MOUSEKEY_TIME_TO_MAX;
-/* ramp used to reach maximum pointer speed (NOT SUPPORTED) */
-//int8_t mk_curve = 0;
+/* ramp used to reach maximum pointer speed (-127-127) */
+int8_t mk_curve = MOUSEKEY_CURVE;
 /* wheel params */
 uint8_t mk_wheel_max_speed = MOUSEKEY_WHEEL_MAX_SPEED;
 uint8_t mk_wheel_time_to_max = MOUSEKEY_WHEEL_TIME_TO_MAX;
 
 
+/* when the last report was due, and when it was made */
 static uint16_t last_timer = 0;
+static uint16_t last_report = 0;
 
 
-static uint8_t move_unit(void)
+/* speed in units per interval, Q8.8 */
+static uint16_t speed(uint8_t delta, uint8_t max_speed, uint8_t time_to_max, uint8_t limit)
 {
-    uint16_t unit;
-    if (mousekey_accel & (1<<0)) {
-        unit = (MOUSEKEY_MOVE_DELTA * mk_max_speed)/4;
-    } else if (mousekey_accel & (1<<1)) {
-        unit = (MOUSEKEY_MOVE_DELTA * mk_max_speed)/2;
-    } else if (mousekey_accel & (1<<2)) {
-        unit = (MOUSEKEY_MOVE_DELTA * mk_max_speed);
-    } else if (mousekey_repeat == 0) {
-        unit = MOUSEKEY_MOVE_DELTA;
-    } else if (mousekey_repeat >= mk_time_to_max) {
-        unit = MOUSEKEY_MOVE_DELTA * mk_max_speed;
-    } else {
-        unit = (MOUSEKEY_MOVE_DELTA * mk_max_speed * mousekey_repeat) / mk_time_to_max;
-    }
-    return (unit > MOUSEKEY_MOVE_MAX ? MOUSEKEY_MOVE_MAX : (unit == 0 ? 1 : unit));
+    uint16_t top = (uint16_t)delta * max_speed;
+    if (top > limit) top = limit;
+    if (top == 0) top = 1;
+
+    if (mousekey_accel & (1<<0)) return (top << 8) / 4;
+    if (mousekey_accel & (1<<1)) return (top << 8) / 2;
+    if (mousekey_accel & (1<<2)) return top << 8;
+
+    uint16_t ramp = (uint16_t)time_to_max * mk_interval;
+    if (mousekey_ramp >= ramp) return top << 8;
+
+    // progress through the ramp, Q0.8, bent by mk_curve
+    int16_t p = ((uint32_t)mousekey_ramp << 8) / ramp;
+    p -= (int32_t)mk_curve * p * (256 - p) / (127 * 256);
+    if (p < 0) p = 0;
+
+    uint16_t v = ((uint32_t)top * (uint16_t)p);
+    return v < 256 ? 256 : v;
 }
 
-static uint8_t wheel_unit(void)
+static uint16_t move_speed(void)
 {
-    uint16_t unit;
-    if (mousekey_accel & (1<<0)) {
-        unit = (MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed)/4;
-    } else if (mousekey_accel & (1<<1)) {
-        unit = (MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed)/2;
-    } else if (mousekey_accel & (1<<2)) {
-        unit = (MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed);
-    } else if (mousekey_repeat == 0) {
-        unit = MOUSEKEY_WHEEL_DELTA;
-    } else if (mousekey_repeat >= mk_wheel_time_to_max) {
-        unit = MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed;
-    } else {
-        unit = (MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed * mousekey_repeat) / mk_wheel_time_to_max;
+    return speed(MOUSEKEY_MOVE_DELTA, mk_max_speed, mk_time_to_max, MOUSEKEY_MOVE_MAX);
+}
+
+static uint16_t wheel_speed(void)
+{
+    return speed(MOUSEKEY_WHEEL_DELTA, mk_wheel_max_speed, mk_wheel_time_to_max, MOUSEKEY_WHEEL_MAX);
+}
+
+/* adds `step` (Q8.8) to an axis and returns the whole units to report */
+static int8_t integrate(uint8_t axis, uint16_t step)
+{
+    int16_t rest = mousekey_rest[axis];
+    if (mousekey_dir[axis] > 0) {
+        rest = (rest + (int32_t)step > INT16_MAX) ? INT16_MAX : rest + step;
+    } else if (mousekey_dir[axis] < 0) {
+        rest = (rest - (int32_t)step < -INT16_MAX) ? -INT16_MAX : rest - step;
     }
-    return (unit > MOUSEKEY_WHEEL_MAX ? MOUSEKEY_WHEEL_MAX : (unit == 0 ? 1 : unit));
+
+    int16_t units = rest / 256;
+    if (units > 127) units = 127;
+    if (units < -127) units = -127;
+    mousekey_rest[axis] = rest - units * 256;
+    return units;
+}
+
+static bool mousekey_moving(void)
+{
+    return mousekey_dir[AXIS_X] || mousekey_dir[AXIS_Y] || mousekey_dir[AXIS_V] || mousekey_dir[AXIS_H];
 }
 
 void mousekey_task(void)
 {
-    if (timer_elapsed(last_timer) < (mousekey_repeat ? mk_interval : mk_delay*10))
+    if (!mousekey_moving())
         return;
 
-    if (mouse_report.x == 0 && mouse_report.y == 0 && mouse_report.v == 0 && mouse_report.h == 0)
-        return;
+    uint16_t elapsed;
+    if (!mousekey_repeating) {
+        if (timer_elapsed(last_timer) < mk_delay*10)
+            return;
+        // the first repeat moves by one full interval
+        mousekey_repeating = true;
+        last_timer = timer_read();
+        elapsed = mk_interval;
+    } else {
+        if (timer_elapsed(last_timer) < mk_interval)
+            return;
+        // keep a fixed report rate, unless the scan fell a whole interval behind
+        last_timer += mk_interval;
+        if (timer_elapsed(last_timer) >= mk_interval)
+            last_timer = timer_read();
+        elapsed = timer_elapsed(last_report);
+    }
+    last_report = timer_read();
+    mousekey_ramp = (mousekey_ramp + (uint32_t)elapsed > UINT16_MAX) ? UINT16_MAX : mousekey_ramp + elapsed;
 
-    if (mousekey_repeat != UINT8_MAX)
-        mousekey_repeat++;
+    // after a stall, catch up by one interval at most instead of jumping
+    uint8_t interval = mk_interval ? mk_interval : 1;
+    if (elapsed > 2 * interval) elapsed = 2 * interval;
 
+    // Q8.8, no more than the report allows
+    uint32_t move = ((uint32_t)move_speed() * elapsed) / interval;
+    uint32_t wheel = ((uint32_t)wheel_speed() * elapsed) / interval;
+    if (move > (uint32_t)MOUSEKEY_MOVE_MAX << 8) move = (uint32_t)MOUSEKEY_MOVE_MAX << 8;
+    if (wheel > (uint32_t)MOUSEKEY_WHEEL_MAX << 8) wheel = (uint32_t)MOUSEKEY_WHEEL_MAX << 8;
 
-    if (mouse_report.x > 0) mouse_report.x = move_unit();
-    if (mouse_report.x < 0) mouse_report.x = move_unit() * -1;
-    if (mouse_report.y > 0) mouse_report.y = move_unit();
-    if (mouse_report.y < 0) mouse_report.y = move_unit() * -1;
+    /* diagonal move [1/sqrt(2) = 181/256] */
+    if (mousekey_dir[AXIS_X] && mousekey_dir[AXIS_Y]) {
+        move = (move * 181) >> 8;
+    }
+
+    mouse_report.x = integrate(AXIS_X, move);
+    mouse_report.y = integrate(AXIS_Y, move);
+    mouse_report.v = integrate(AXIS_V, wheel);
+    mouse_report.h = integrate(AXIS_H, wheel);
+
+    if (mouse_report.x || mouse_report.y || mouse_report.v || mouse_report.h) {
+        mousekey_send();
+    }
+}
 
-    /* diagonal move [1/sqrt(2) = 0.7] */
-    if (mouse_report.x && mouse_report.y) {
-        mouse_report.x *= 0.7;
-        mouse_report.y *= 0.7;
+static void mousekey_start(uint8_t axis, int8_t dir)
+{
+    if (!mousekey_moving()) {
+        // a fresh press moves one step right away, see mousekey_send()
+        mousekey_repeating = false;
+        mousekey_ramp = 0;
+        last_timer = timer_read();
+        for (uint8_t i = 0; i < AXES; i++) {
+            mousekey_rest[i] = 0;
+        }
     }
+    mousekey_dir[axis] = dir;
+    mousekey_rest[axis] = 0;
 
-    if (mouse_report.v > 0) mouse_report.v = wheel_unit();
-    if (mouse_report.v < 0) mouse_report.v = wheel_unit() * -1;
-    if (mouse_report.h > 0) mouse_report.h = wheel_unit();
-    if (mouse_report.h < 0) mouse_report.h = wheel_unit() * -1;
+    bool move = (axis == AXIS_X || axis == AXIS_Y);
+    uint8_t unit = move ? MOUSEKEY_MOVE_DELTA : MOUSEKEY_WHEEL_DELTA;
+    if (mousekey_accel) {
+        unit = (move ? move_speed() : wheel_speed()) >> 8;
+    }
+    if (!mousekey_repeating) {
+        switch (axis) {
+            case AXIS_X: mouse_report.x = dir * unit; break;
+            case AXIS_Y: mouse_report.y = dir * unit; break;
+            case AXIS_V: mouse_report.v = dir * unit; break;
+            case AXIS_H: mouse_report.h = dir * unit; break;
+        }
+    }
+}
 
-    mousekey_send();
+static void mousekey_stop(uint8_t axis, int8_t dir)
+{
+    if (mousekey_dir[axis] == dir) {
+        mousekey_dir[axis] = 0;
+        mousekey_rest[axis] = 0;
+    }
 }
 
 void mousekey_on(uint8_t code)
 {
-    if      (code == KC_MS_UP)       mouse_report.y = move_unit() * -1;
-    else if (code == KC_MS_DOWN)     mouse_report.y = move_unit();
-    else if (code == KC_MS_LEFT)     mouse_report.x = move_unit() * -1;
-    else if (code == KC_MS_RIGHT)    mouse_report.x = move_unit();
-    else if (code == KC_MS_WH_UP)    mouse_report.v = wheel_unit();
-    else if (code == KC_MS_WH_DOWN)  mouse_report.v = wheel_unit() * -1;
-    else if (code == KC_MS_WH_LEFT)  mouse_report.h = wheel_unit() * -1;
-    else if (code == KC_MS_WH_RIGHT) mouse_report.h = wheel_unit();
+    if      (code == KC_MS_UP)       mousekey_start(AXIS_Y, -1);
+    else if (code == KC_MS_DOWN)     mousekey_start(AXIS_Y, 1);
+    else if (code == KC_MS_LEFT)     mousekey_start(AXIS_X, -1);
+    else if (code == KC_MS_RIGHT)    mousekey_start(AXIS_X, 1);
+    else if (code == KC_MS_WH_UP)    mousekey_start(AXIS_V, 1);
+    else if (code == KC_MS_WH_DOWN)  mousekey_start(AXIS_V, -1);
+    else if (code == KC_MS_WH_LEFT)  mousekey_start(AXIS_H, -1);
+    else if (code == KC_MS_WH_RIGHT) mousekey_start(AXIS_H, 1);
     else if (code == KC_MS_BTN1)     mouse_report.buttons |= MOUSE_BTN1;
     else if (code == KC_MS_BTN2)     mouse_report.buttons |= MOUSE_BTN2;
     else if (code == KC_MS_BTN3)     mouse_report.buttons |= MOUSE_BTN3;
@@ -147,14 +237,14 @@ void mousekey_on(uint8_t code)
 
 void mousekey_off(uint8_t code)
 {
-    if      (code == KC_MS_UP       && mouse_report.y < 0) mouse_report.y = 0;
-    else if (code == KC_MS_DOWN     && mouse_report.y > 0) mouse_report.y = 0;
-    else if (code == KC_MS_LEFT     && mouse_report.x < 0) mouse_report.x = 0;
-    else if (code == KC_MS_RIGHT    && mouse_report.x > 0) mouse_report.x = 0;
-    else if (code == KC_MS_WH_UP    && mouse_report.v > 0) mouse_report.v = 0;
-    else if (code == KC_MS_WH_DOWN  && mouse_report.v < 0) mouse_report.v = 0;
-    else if (code == KC_MS_WH_LEFT  && mouse_report.h < 0) mouse_report.h = 0;
-    else if (code == KC_MS_WH_RIGHT && mouse_report.h > 0) mouse_report.h = 0;
+    if      (code == KC_MS_UP)       mousekey_stop(AXIS_Y, -1);
+    else if (code == KC_MS_DOWN)     mousekey_stop(AXIS_Y, 1);
+    else if (code == KC_MS_LEFT)     mousekey_stop(AXIS_X, -1);
+    else if (code == KC_MS_RIGHT)    mousekey_stop(AXIS_X, 1);
+    else if (code == KC_MS_WH_UP)    mousekey_stop(AXIS_V, 1);
+    else if (code == KC_MS_WH_DOWN)  mousekey_stop(AXIS_V, -1);
+    else if (code == KC_MS_WH_LEFT)  mousekey_stop(AXIS_H, -1);
+    else if (code == KC_MS_WH_RIGHT) mousekey_stop(AXIS_H, 1);
     else if (code == KC_MS_BTN1) mouse_report.buttons &= ~MOUSE_BTN1;
     else if (code == KC_MS_BTN2) mouse_report.buttons &= ~MOUSE_BTN2;
     else if (code == KC_MS_BTN3) mouse_report.buttons &= ~MOUSE_BTN3;
@@ -163,34 +253,39 @@ void mousekey_off(uint8_t code)
     else if (code == KC_MS_ACCEL0) mousekey_accel &= ~(1<<0);
     else if (code == KC_MS_ACCEL1) mousekey_accel &= ~(1<<1);
     else if (code == KC_MS_ACCEL2) mousekey_accel &= ~(1<<2);
-
-    if (mouse_report.x == 0 && mouse_report.y == 0 && mouse_report.v == 0 && mouse_report.h == 0)
-        mousekey_repeat = 0;
 }
 
+/* Motion in the report is relative, so it is cleared once handed on. */
 void mousekey_send(void)
 {
     mousekey_debug();
-    host_mouse_send(&mouse_report);
-    last_timer = timer_read();
+    pointer_add(POINTER_MOUSEKEY, &mouse_report);
+    mouse_report.x = 0;
+    mouse_report.y = 0;
+    mouse_report.v = 0;
+    mouse_report.h = 0;
 }
 
 void mousekey_clear(void)
 {
     mouse_report = (report_mouse_t){};
-    mousekey_repeat = 0;
+    for (uint8_t i = 0; i < AXES; i++) {
+        mousekey_dir[i] = 0;
+        mousekey_rest[i] = 0;
+    }
+    mousekey_repeating = false;
     mousekey_accel = 0;
 }
 
 static void mousekey_debug(void)
 {
     if (!debug_mouse) return;
-    print("mousekey [btn|x y v h](rep/acl): [");
+    print("mousekey [btn|x y v h](ramp/acl): [");
     phex(mouse_report.buttons); print("|");
     print_decs(mouse_report.x); print(" ");
     print_decs(mouse_report.y); print(" ");
     print_decs(mouse_report.v); print(" ");
     print_decs(mouse_report.h); print("](");
-    print_dec(mousekey_repeat); print("/");
+    print_dec(mousekey_ramp); print("/");
     print_dec(mousekey_accel); print(")\n");
 }
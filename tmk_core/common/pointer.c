@@ -0,0 +1,133 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "host.h"
+#include "timer.h"
+#include "pointer.h"
+
+
+enum { AXIS_X, AXIS_Y, AXIS_V, AXIS_H, AXES };
+
+enum { SCROLL_NONE, SCROLL_BTN, SCROLL_SENT };
+
+typedef struct {
+    uint8_t  buttons;           // scroll mode while all of these are held
+    uint8_t  divisor_v;
+    uint8_t  divisor_h;
+    uint8_t  state;
+    uint16_t tap;
+    uint16_t time;              // when the scroll buttons went down
+    int16_t  rest_v;            // motion not turned into scrolling yet
+    int16_t  rest_h;
+} pointer_scroll_t;
+
+static uint8_t source_buttons[POINTER_SOURCES];
+static pointer_scroll_t scroll[POINTER_SOURCES];
+
+static int16_t  motion[AXES];   // not reported yet
+static uint8_t  clicked = 0;    // pressed since the last report
+static uint8_t  sent_buttons = 0;
+static uint16_t last_report = 0;
+
+
+void pointer_set_scroll(pointer_source_t source, uint8_t buttons, uint16_t tap,
+                        uint8_t divisor_v, uint8_t divisor_h)
+{
+    scroll[source] = (pointer_scroll_t){
+        .buttons = buttons,
+        .divisor_v = divisor_v ? divisor_v : 1,
+        .divisor_h = divisor_h ? divisor_h : 1,
+        .tap = tap,
+    };
+}
+
+static void pointer_scroll(pointer_scroll_t *s, uint8_t *buttons, int16_t *delta)
+{
+    if ((*buttons & s->buttons) == s->buttons) {
+        if (s->state == SCROLL_NONE) {
+            s->time = timer_read();
+            s->state = SCROLL_BTN;
+        }
+        if (delta[AXIS_X] || delta[AXIS_Y]) {
+            s->state = SCROLL_SENT;
+            s->rest_v -= delta[AXIS_Y];
+            s->rest_h += delta[AXIS_X];
+            delta[AXIS_V] += s->rest_v / s->divisor_v;
+            delta[AXIS_H] += s->rest_h / s->divisor_h;
+            s->rest_v %= s->divisor_v;
+            s->rest_h %= s->divisor_h;
+            delta[AXIS_X] = 0;
+            delta[AXIS_Y] = 0;
+        }
+    } else if (!(*buttons & s->buttons)) {
+        if (s->state == SCROLL_BTN && timer_elapsed(s->time) < s->tap) {
+            clicked |= s->buttons;
+        }
+        s->state = SCROLL_NONE;
+        s->rest_v = 0;
+        s->rest_h = 0;
+    }
+    *buttons &= ~s->buttons;
+}
+
+static void accumulate(uint8_t axis, int16_t delta)
+{
+    if (delta > 0 && motion[axis] > INT16_MAX - delta) {
+        motion[axis] = INT16_MAX;
+    } else if (delta < 0 && motion[axis] < INT16_MIN - delta) {
+        motion[axis] = INT16_MIN;
+    } else {
+        motion[axis] += delta;
+    }
+}
+
+void pointer_add(pointer_source_t source, const report_mouse_t *report)
+{
+    uint8_t buttons = report->buttons;
+    int16_t delta[AXES] = { report->x, report->y, report->v, report->h };
+
+    if (scroll[source].buttons) {
+        pointer_scroll(&scroll[source], &buttons, delta);
+    }
+
+    clicked |= buttons & ~source_buttons[source];
+    source_buttons[source] = buttons;
+
+    for (uint8_t i = 0; i < AXES; i++) {
+        accumulate(i, delta[i]);
+    }
+}
+
+/* Takes as much of the motion as fits in a report, the rest stays */
+static int8_t take(uint8_t axis)
+{
+    int16_t m = motion[axis];
+    int8_t out = m > 127 ? 127 : (m < -127 ? -127 : m);
+    motion[axis] -= out;
+    return out;
+}
+
+void pointer_task(void)
+{
+    if (timer_elapsed(last_report) < POINTER_INTERVAL) return;
+
+    uint8_t buttons = clicked;
+    for (uint8_t i = 0; i < POINTER_SOURCES; i++) {
+        buttons |= source_buttons[i];
+    }
+    if (buttons == sent_buttons &&
+            !motion[AXIS_X] && !motion[AXIS_Y] && !motion[AXIS_V] && !motion[AXIS_H]) {
+        return;
+    }
+
+    report_mouse_t report = {
+        .buttons = buttons,
+        .x = take(AXIS_X),
+        .y = take(AXIS_Y),
+        .v = take(AXIS_V),
+        .h = take(AXIS_H),
+    };
+    clicked = 0;
+    sent_buttons = buttons;
+    last_report = timer_read();
+    host_mouse_send(&report);
+}
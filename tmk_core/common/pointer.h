@@ -0,0 +1,50 @@
+#ifndef POINTER_H
+#define POINTER_H
+
+#include <stdint.h>
+#include "report.h"
+
+/* Pointer aggregation
+ *
+ * Every mouse source (mouse keys, PS/2, serial and ADB mice) hands its
+ * reports to pointer_add() instead of sending them. Motion is summed across
+ * sources, buttons are ORed, and pointer_task() sends at most one report per
+ * POINTER_INTERVAL. Motion beyond what fits in one report is carried over to
+ * the next, and a button pressed and released between two reports is still
+ * sent as a click.
+ */
+
+/* ms between mouse reports, the polling interval of the mouse endpoint */
+#ifndef POINTER_INTERVAL
+#define POINTER_INTERVAL 10
+#endif
+
+typedef enum {
+    POINTER_MOUSEKEY,
+    POINTER_PS2,
+    POINTER_SERIAL,
+    POINTER_ADB,
+    POINTER_SOURCES
+} pointer_source_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* report->buttons is the state of the source's buttons, x/y/v/h are relative */
+void pointer_add(pointer_source_t source, const report_mouse_t *report);
+
+/* While all of `buttons` are held, motion of the source scrolls instead,
+ * divided by divisor_v and divisor_h. Those buttons are not sent, except as
+ * a click when released within `tap` ms without any motion (0 to disable).
+ * `buttons` 0 turns scrolling off. */
+void pointer_set_scroll(pointer_source_t source, uint8_t buttons, uint16_t tap,
+                        uint8_t divisor_v, uint8_t divisor_h);
+
+void pointer_task(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
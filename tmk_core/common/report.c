@@ -0,0 +1,52 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "report.h"
+
+
+static bool has_key(const report_keyboard_t *report, uint8_t code)
+{
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        if (report->keys[i] == code) return true;
+    }
+    return false;
+}
+
+typedef struct {
+    uint8_t mods_down;
+    uint8_t mods_up;
+    bool    keys_down;
+    bool    keys_up;
+} keyboard_change_t;
+
+static keyboard_change_t keyboard_change(const report_keyboard_t *from, const report_keyboard_t *to)
+{
+    keyboard_change_t c = {
+        .mods_down = to->mods & ~from->mods,
+        .mods_up = from->mods & ~to->mods,
+    };
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        if (to->keys[i] && !has_key(from, to->keys[i])) c.keys_down = true;
+        if (from->keys[i] && !has_key(to, from->keys[i])) c.keys_up = true;
+    }
+    return c;
+}
+
+/* True if `last`, the report before `next`, need not reach the host. That
+ * holds when `next` changes nothing, when both only release keys, or when
+ * `last` only presses modifiers and `next` presses the keys they go with.
+ * Anything else would lose a keystroke or reorder presses and releases. */
+bool keyboard_report_mergeable(const report_keyboard_t *prev, const report_keyboard_t *last,
+                               const report_keyboard_t *next)
+{
+    keyboard_change_t first = keyboard_change(prev, last);
+    keyboard_change_t then = keyboard_change(last, next);
+
+    if (!then.mods_down && !then.mods_up && !then.keys_down && !then.keys_up) {
+        return true;
+    }
+    if (!first.mods_down && !first.keys_down && !then.mods_down && !then.keys_down) {
+        return true;
+    }
+    return !first.mods_up && !first.keys_down && !first.keys_up &&
+           !then.mods_up && !then.keys_up;
+}
@@ -19,6 +19,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define REPORT_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "keycode.h"
 
 
@@ -181,6 +182,14 @@ typedef struct {
     (key == KC_WWW_REFRESH      ?  AC_REFRESH : \
     (key == KC_WWW_FAVORITES    ?  AC_BOOKMARKS : 0)))))))))))))))))))))
 
+/* True if `last`, the 6KRO report between `prev` and `next`, need not reach
+ * the host. That holds when `next` changes nothing, when both only release
+ * keys, or when `last` only presses modifiers and `next` presses the keys
+ * they go with. Anything else would lose a keystroke or reorder presses and
+ * releases. */
+bool keyboard_report_mergeable(const report_keyboard_t *prev, const report_keyboard_t *last,
+                               const report_keyboard_t *next);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,139 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Single producer, single consumer ring
+ *
+ * For a queue between one writer and one reader, like an interrupt handler
+ * and the main loop. The producer only writes head and the consumer only
+ * writes tail. Both are single bytes, so each side reads the other's index
+ * in one go and neither has to turn interrupts off.
+ *
+ * The indexes run freely and are masked with size - 1 on access, so size
+ * has to be a power of two no larger than 128, and all of it holds data.
+ * The storage belongs to the caller and may be of any type; the functions
+ * taking a uint8_t buffer are for the common case of a byte queue.
+ */
+
+typedef struct {
+    volatile uint8_t head;      // next slot to fill, written by the producer
+    volatile uint8_t tail;      // next slot to take, written by the consumer
+} spsc_ring_t;
+
+#define SPSC_RING_SIZE_VALID(size) ((size) > 0 && (size) <= 128 && !((size) & ((size) - 1)))
+
+/* Keeps the compiler from moving memory accesses across. A single core sees
+ * its own stores in order, which is all AVR and Cortex-M need. Elsewhere it
+ * is a full fence, for the native tests running each side on a thread. */
+#if defined(__AVR__) || defined(__arm__)
+#   define SPSC_RING_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+#else
+#   define SPSC_RING_BARRIER() __sync_synchronize()
+#endif
+
+static inline void spsc_ring_init(spsc_ring_t *r)
+{
+    r->head = r->tail = 0;
+}
+
+/* Either side */
+static inline uint8_t spsc_ring_count(const spsc_ring_t *r)
+{
+    uint8_t count = r->head - r->tail;
+    SPSC_RING_BARRIER();
+    return count;
+}
+
+static inline bool spsc_ring_empty(const spsc_ring_t *r)
+{
+    return !spsc_ring_count(r);
+}
+
+static inline uint8_t spsc_ring_space(const spsc_ring_t *r, uint8_t size)
+{
+    return size - spsc_ring_count(r);
+}
+
+/* Producer: fill the slot i past head, then commit the slots filled */
+static inline uint8_t spsc_ring_in(const spsc_ring_t *r, uint8_t size, uint8_t i)
+{
+    return (uint8_t)(r->head + i) & (size - 1);
+}
+
+static inline void spsc_ring_commit(spsc_ring_t *r, uint8_t n)
+{
+    SPSC_RING_BARRIER();
+    r->head += n;
+}
+
+/* Consumer: take the slot i past tail, then release the slots taken */
+static inline uint8_t spsc_ring_out(const spsc_ring_t *r, uint8_t size, uint8_t i)
+{
+    return (uint8_t)(r->tail + i) & (size - 1);
+}
+
+static inline void spsc_ring_release(spsc_ring_t *r, uint8_t n)
+{
+    SPSC_RING_BARRIER();
+    r->tail += n;
+}
+
+/* Consumer: drops everything queued */
+static inline void spsc_ring_flush(spsc_ring_t *r)
+{
+    r->tail = r->head;
+}
+
+
+/* Byte queues */
+static inline bool spsc_ring_put(spsc_ring_t *r, uint8_t *buf, uint8_t size, uint8_t data)
+{
+    if (!spsc_ring_space(r, size)) return false;
+    buf[spsc_ring_in(r, size, 0)] = data;
+    spsc_ring_commit(r, 1);
+    return true;
+}
+
+static inline bool spsc_ring_get(spsc_ring_t *r, const uint8_t *buf, uint8_t size, uint8_t *data)
+{
+    if (spsc_ring_empty(r)) return false;
+    *data = buf[spsc_ring_out(r, size, 0)];
+    spsc_ring_release(r, 1);
+    return true;
+}
+
+/* Only valid for i < spsc_ring_count() */
+static inline uint8_t spsc_ring_peek(const spsc_ring_t *r, const uint8_t *buf, uint8_t size, uint8_t i)
+{
+    return buf[spsc_ring_out(r, size, i)];
+}
+
+/* Queues as much of src as fits, returns how much that was */
+static inline uint8_t spsc_ring_write(spsc_ring_t *r, uint8_t *buf, uint8_t size,
+                                      const uint8_t *src, uint8_t n)
+{
+    uint8_t space = spsc_ring_space(r, size);
+    if (n > space) n = space;
+    for (uint8_t i = 0; i < n; i++) {
+        buf[spsc_ring_in(r, size, i)] = src[i];
+    }
+    spsc_ring_commit(r, n);
+    return n;
+}
+
+/* Takes up to n bytes, returns how many there were */
+static inline uint8_t spsc_ring_read(spsc_ring_t *r, const uint8_t *buf, uint8_t size,
+                                     uint8_t *dst, uint8_t n)
+{
+    uint8_t count = spsc_ring_count(r);
+    if (n > count) n = count;
+    for (uint8_t i = 0; i < n; i++) {
+        dst[i] = buf[spsc_ring_out(r, size, i)];
+    }
+    spsc_ring_release(r, n);
+    return n;
+}
+
+#endif
@@ -0,0 +1,82 @@
+#include "gtest/gtest.h"
+#include <vector>
+
+extern "C" {
+#include "action.h"
+#include "action_layer.h"
+#include "keycode.h"
+}
+
+static const keypos_t K0 = { .col = 0, .row = 0 };
+static const keypos_t K1 = { .col = 1, .row = 0 };
+
+// released actions as their code negated
+static std::vector<int> processed;
+
+extern "C" {
+bool disable_action_cache = false;
+
+uint16_t timer_read(void) { return 1; }
+
+action_t action_for_key(uint8_t layer, keypos_t key) {
+    action_t action;
+    if (key.col == 0) {
+        action.code = layer == 0 ? ACTION_KEY(KC_A) : ACTION_LAYER_MOMENTARY(2);
+    } else {
+        action.code = layer == 0 ? ACTION_KEY(KC_C) : ACTION_KEY(KC_B);
+    }
+    return action;
+}
+
+void process_action(keyrecord_t *record, action_t action) {
+    processed.push_back(record->event.pressed ? action.code : -action.code);
+}
+}
+
+class ActionLayer : public testing::Test {
+public:
+    ActionLayer() {
+        layer_clear();
+        processed.clear();
+    }
+    action_t press(keypos_t key) {
+        update_held_keys(key, true);
+        return store_or_get_action(true, key);
+    }
+    action_t release(keypos_t key) {
+        update_held_keys(key, false);
+        return store_or_get_action(false, key);
+    }
+};
+
+TEST_F(ActionLayer, swaps_a_held_key_for_the_key_under_it) {
+    EXPECT_EQ(press(K1).code, ACTION_KEY(KC_C));
+    layer_on(1);
+    EXPECT_EQ(processed, std::vector<int>({-ACTION_KEY(KC_C), ACTION_KEY(KC_B)}));
+    EXPECT_EQ(release(K1).code, ACTION_KEY(KC_B));
+}
+
+TEST_F(ActionLayer, releases_a_held_key_over_a_layer_key_once) {
+    EXPECT_EQ(press(K0).code, ACTION_KEY(KC_A));
+    layer_on(1);
+    EXPECT_EQ(processed, std::vector<int>({-ACTION_KEY(KC_A)}));
+    EXPECT_EQ(release(K0).code, ACTION_NO);
+    layer_off(1);
+    EXPECT_EQ(processed, std::vector<int>({-ACTION_KEY(KC_A)}));
+}
+
+TEST_F(ActionLayer, presses_a_released_key_again) {
+    press(K0);
+    layer_on(1);
+    release(K0);
+    EXPECT_EQ(press(K0).code, ACTION_LAYER_MOMENTARY(2));
+    EXPECT_EQ(release(K0).code, ACTION_LAYER_MOMENTARY(2));
+}
+
+TEST_F(ActionLayer, keeps_layer_keys_held) {
+    layer_on(1);
+    EXPECT_EQ(press(K0).code, ACTION_LAYER_MOMENTARY(2));
+    layer_off(1);
+    EXPECT_TRUE(processed.empty());
+    EXPECT_EQ(release(K0).code, ACTION_LAYER_MOMENTARY(2));
+}
@@ -0,0 +1,9 @@
+spsc_ring_SRC := \
+	$(TMK_PATH)/common/tests/spsc_ring_tests.cpp \
+	$(TMK_PATH)/protocol/midi/bytequeue/bytequeue.c
+
+action_layer_SRC := \
+	$(TMK_PATH)/common/tests/action_layer_tests.cpp \
+	$(TMK_PATH)/common/action_layer.c
+action_layer_DEFS := \
+	-DMATRIX_ROWS=4 -DMATRIX_COLS=4 -DPREVENT_STUCK_MODIFIERS
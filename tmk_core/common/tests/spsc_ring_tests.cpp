@@ -0,0 +1,188 @@
+#include "gtest/gtest.h"
+#include <thread>
+#include <chrono>
+#include "common/spsc_ring.h"
+#include "protocol/lufa/ringbuffer.hpp"
+#include "protocol/midi/bytequeue/bytequeue.h"
+
+#define SIZE 16
+
+class SpscRing : public testing::Test {
+public:
+    SpscRing() {
+        spsc_ring_init(&ring);
+    }
+    spsc_ring_t ring;
+    uint8_t buf[SIZE];
+};
+
+TEST_F(SpscRing, is_empty_after_init) {
+    uint8_t data;
+    EXPECT_TRUE(spsc_ring_empty(&ring));
+    EXPECT_EQ(spsc_ring_space(&ring, SIZE), SIZE);
+    EXPECT_FALSE(spsc_ring_get(&ring, buf, SIZE, &data));
+}
+
+TEST_F(SpscRing, gets_what_was_put_in_order) {
+    uint8_t data;
+    EXPECT_TRUE(spsc_ring_put(&ring, buf, SIZE, 1));
+    EXPECT_TRUE(spsc_ring_put(&ring, buf, SIZE, 2));
+    EXPECT_EQ(spsc_ring_count(&ring), 2);
+    EXPECT_TRUE(spsc_ring_get(&ring, buf, SIZE, &data));
+    EXPECT_EQ(data, 1);
+    EXPECT_TRUE(spsc_ring_get(&ring, buf, SIZE, &data));
+    EXPECT_EQ(data, 2);
+    EXPECT_TRUE(spsc_ring_empty(&ring));
+}
+
+TEST_F(SpscRing, uses_every_slot) {
+    for (int i = 0; i < SIZE; i++) {
+        EXPECT_TRUE(spsc_ring_put(&ring, buf, SIZE, i));
+    }
+    EXPECT_FALSE(spsc_ring_put(&ring, buf, SIZE, 0xFF));
+    EXPECT_EQ(spsc_ring_count(&ring), SIZE);
+    for (int i = 0; i < SIZE; i++) {
+        EXPECT_EQ(spsc_ring_peek(&ring, buf, SIZE, i), i);
+    }
+}
+
+TEST_F(SpscRing, wraps_around_the_indexes) {
+    uint8_t data;
+    for (int i = 0; i < 1000; i++) {
+        EXPECT_TRUE(spsc_ring_put(&ring, buf, SIZE, i & 0xFF));
+        EXPECT_TRUE(spsc_ring_put(&ring, buf, SIZE, ~i & 0xFF));
+        EXPECT_TRUE(spsc_ring_get(&ring, buf, SIZE, &data));
+        EXPECT_EQ(data, i & 0xFF);
+        EXPECT_TRUE(spsc_ring_get(&ring, buf, SIZE, &data));
+        EXPECT_EQ(data, ~i & 0xFF);
+    }
+    EXPECT_TRUE(spsc_ring_empty(&ring));
+}
+
+TEST_F(SpscRing, writes_and_reads_batches_as_far_as_they_fit) {
+    uint8_t src[SIZE + 4];
+    uint8_t dst[SIZE + 4];
+    for (int i = 0; i < SIZE + 4; i++) src[i] = i;
+    EXPECT_TRUE(spsc_ring_put(&ring, buf, SIZE, 0xAA));
+    EXPECT_EQ(spsc_ring_write(&ring, buf, SIZE, src, SIZE + 4), SIZE - 1);
+    EXPECT_EQ(spsc_ring_read(&ring, buf, SIZE, dst, 1), 1);
+    EXPECT_EQ(dst[0], 0xAA);
+    EXPECT_EQ(spsc_ring_read(&ring, buf, SIZE, dst, SIZE + 4), SIZE - 1);
+    for (int i = 0; i < SIZE - 1; i++) {
+        EXPECT_EQ(dst[i], i);
+    }
+}
+
+TEST_F(SpscRing, flush_drops_everything) {
+    spsc_ring_put(&ring, buf, SIZE, 1);
+    spsc_ring_put(&ring, buf, SIZE, 2);
+    spsc_ring_flush(&ring);
+    EXPECT_TRUE(spsc_ring_empty(&ring));
+    EXPECT_EQ(spsc_ring_space(&ring, SIZE), SIZE);
+}
+
+TEST_F(SpscRing, passes_every_byte_between_threads) {
+    const uint32_t count = 1000000;
+    uint32_t errors = 0;
+
+    std::thread consumer([&]() {
+        uint8_t chunk[7];
+        uint32_t received = 0;
+        while (received < count) {
+            uint8_t n = spsc_ring_read(&ring, buf, SIZE, chunk, sizeof(chunk));
+            if (!n) std::this_thread::yield();
+            for (uint8_t i = 0; i < n; i++) {
+                if (chunk[i] != (uint8_t)(received++ * 7)) errors++;
+            }
+        }
+    });
+    uint32_t sent = 0;
+    while (sent < count) {
+        // alternate single bytes and batches
+        if (!spsc_ring_space(&ring, SIZE)) {
+            std::this_thread::yield();
+        } else if (sent & 1) {
+            if (spsc_ring_put(&ring, buf, SIZE, (uint8_t)(sent * 7))) sent++;
+        } else {
+            uint8_t chunk[5];
+            uint8_t n = count - sent < sizeof(chunk) ? count - sent : sizeof(chunk);
+            for (uint8_t i = 0; i < n; i++) chunk[i] = (uint8_t)((sent + i) * 7);
+            sent += spsc_ring_write(&ring, buf, SIZE, chunk, n);
+        }
+    }
+    consumer.join();
+    EXPECT_EQ(errors, 0);
+    EXPECT_TRUE(spsc_ring_empty(&ring));
+}
+
+// prints a timing, run it with --gtest_also_run_disabled_tests
+TEST_F(SpscRing, DISABLED_benchmark_put_and_get) {
+    const uint32_t count = 1000000;
+    uint8_t data = 0;
+    uint32_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < count; i++) {
+        spsc_ring_put(&ring, buf, SIZE, i);
+        spsc_ring_get(&ring, buf, SIZE, &data);
+        sum += data;
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    printf("put and get: %.1f ns\n", (double)ns / count);
+    EXPECT_NE(sum, 0);
+}
+
+struct item {
+    uint16_t a;
+    uint8_t b;
+};
+
+TEST(RingBuffer, holds_size_elements) {
+    RingBuffer<item, 4> ring;
+    item it;
+    for (int i = 0; i < 4; i++) {
+        EXPECT_TRUE(ring.enqueue({(uint16_t)(i * 1000), (uint8_t)i}));
+        EXPECT_EQ(ring.back().b, i);
+    }
+    EXPECT_FALSE(ring.enqueue({0, 0}));
+    EXPECT_EQ(ring.size(), 4);
+    EXPECT_TRUE(ring.peek(it));
+    EXPECT_EQ(it.a, 0);
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(ring.front().b, i);
+        EXPECT_TRUE(ring.get(it));
+        EXPECT_EQ(it.a, i * 1000);
+    }
+    EXPECT_TRUE(ring.empty());
+    EXPECT_FALSE(ring.get(it));
+}
+
+TEST(RingBuffer, holds_one_element_with_size_one) {
+    RingBuffer<uint16_t, 1> ring;
+    uint16_t value;
+    EXPECT_TRUE(ring.enqueue(1234));
+    EXPECT_FALSE(ring.enqueue(5678));
+    EXPECT_TRUE(ring.get(value));
+    EXPECT_EQ(value, 1234);
+    EXPECT_TRUE(ring.enqueue(5678));
+    EXPECT_EQ(ring.back(), 5678);
+}
+
+TEST(ByteQueue, holds_nothing_with_an_invalid_length) {
+    uint8_t data[12];
+    byteQueue_t queue;
+    bytequeue_init(&queue, data, sizeof(data));
+    EXPECT_FALSE(bytequeue_enqueue(&queue, 1));
+    EXPECT_EQ(bytequeue_length(&queue), 0);
+}
+
+TEST(ByteQueue, uses_all_of_a_valid_length) {
+    uint8_t data[8];
+    byteQueue_t queue;
+    bytequeue_init(&queue, data, sizeof(data));
+    for (int i = 0; i < 8; i++) {
+        EXPECT_TRUE(bytequeue_enqueue(&queue, i));
+    }
+    EXPECT_FALSE(bytequeue_enqueue(&queue, 8));
+    EXPECT_EQ(bytequeue_get(&queue, 7), 7);
+}
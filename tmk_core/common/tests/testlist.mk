@@ -0,0 +1,3 @@
+TEST_LIST +=\
+	spsc_ring\
+	action_layer
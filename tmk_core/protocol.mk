@@ -25,6 +25,10 @@ ifdef PS2_USE_USART
     OPT_DEFS += -DPS2_USE_USART
 endif
 
+ifneq ($(PS2_USE_BUSYWAIT)$(PS2_USE_INT)$(PS2_USE_USART),)
+    SRC += protocol/scan_decoder.c
+endif
+
 
 ifdef SERIAL_MOUSE_MICROSOFT_ENABLE
     SRC += $(PROTOCOL_DIR)/serial_mouse_microsoft.c
@@ -44,6 +48,14 @@ endif
 
 ifdef SERIAL_MOUSE_USE_UART
     SRC += $(PROTOCOL_DIR)/serial_uart.c
+    SRC += $(PROTOCOL_DIR)/serial_tx.c
+endif
+
+# adb_timer.c replaces adb.c, which a keyboard adds to SRC itself
+ifdef ADB_USE_TIMER
+    SRC := $(filter-out protocol/adb.c $(TMK_DIR)/protocol/adb.c,$(SRC))
+    SRC += protocol/adb_timer.c
+    OPT_DEFS += -DADB_USE_TIMER
 endif
 
 ifdef ADB_MOUSE_ENABLE
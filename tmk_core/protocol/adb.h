@@ -53,6 +53,8 @@ POSSIBILITY OF SUCH DAMAGE.
 
 
 // ADB host
+// With ADB_USE_TIMER the recv functions don't wait for the device, they return
+// what it sent to the previous call and start the next transaction instead.
 void     adb_host_init(void);
 bool     adb_host_psw(void);
 uint16_t adb_host_kbd_recv(void);
@@ -0,0 +1,369 @@
+/*
+ * ADB host driven by a 16-bit timer
+ *
+ * Same interface as adb.c, but nothing in it waits. Output compare A times
+ * the bit cells going out, input capture timestamps the edges coming in and
+ * output compare B times out when an edge doesn't come. A poll returns the
+ * result of the previous transaction of that device and starts the next one,
+ * so the main loop only spends the time to do that and a transaction takes
+ * the CPU only for the few us of each interrupt.
+ *
+ * The data line has to be on the input capture pin of the timer, ICP1(PD4)
+ * for Timer1 and ICP3(PC7) for Timer3 on the ATmega32U4. Timer1 is also
+ * used by backlight and sleep LED, Timer3 by audio.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include "adb.h"
+
+
+#ifndef ADB_TIMER
+#define ADB_TIMER 1
+#endif
+
+#define TIMER_REG(reg, n, x)  TIMER_REG_(reg, n, x)
+#define TIMER_REG_(reg, n, x) reg##n##x
+#define TIMER_VECT(n, x)      TIMER_VECT_(n, x)
+#define TIMER_VECT_(n, x)     TIMER##n##_##x##_vect
+
+#define TCCRA   TIMER_REG(TCCR, ADB_TIMER, A)
+#define TCCRB   TIMER_REG(TCCR, ADB_TIMER, B)
+#define TCNT    TIMER_REG(TCNT, ADB_TIMER, )
+#define OCRA    TIMER_REG(OCR, ADB_TIMER, A)
+#define OCRB    TIMER_REG(OCR, ADB_TIMER, B)
+#define ICR     TIMER_REG(ICR, ADB_TIMER, )
+#define TIMSK   TIMER_REG(TIMSK, ADB_TIMER, )
+#define TIFR    TIMER_REG(TIFR, ADB_TIMER, )
+#define ICNC    TIMER_REG(ICNC, ADB_TIMER, )
+#define ICES    TIMER_REG(ICES, ADB_TIMER, )
+#define CS1     TIMER_REG(CS, ADB_TIMER, 1)
+#define ICIE    TIMER_REG(ICIE, ADB_TIMER, )
+#define OCIEA   TIMER_REG(OCIE, ADB_TIMER, A)
+#define OCIEB   TIMER_REG(OCIE, ADB_TIMER, B)
+#define ICF     TIMER_REG(ICF, ADB_TIMER, )
+#define OCFA    TIMER_REG(OCF, ADB_TIMER, A)
+#define OCFB    TIMER_REG(OCF, ADB_TIMER, B)
+
+/* The timer runs at F_CPU/8 */
+#define US(us)  ((uint16_t)((us) * (F_CPU / 8 / 1000000UL)))
+
+
+#define data_lo() (ADB_DDR |=  (1<<ADB_DATA_BIT))
+#define data_hi() (ADB_DDR &= ~(1<<ADB_DATA_BIT))
+#define data_in() (ADB_PIN &   (1<<ADB_DATA_BIT))
+
+#ifdef ADB_PSW_BIT
+static inline void psw_hi(void);
+static inline bool psw_in(void);
+#endif
+
+
+enum {
+    ADDR_KEYB  = 0x20,
+    ADDR_MOUSE = 0x30
+};
+
+enum {
+    IDLE,
+    COMMAND,        // attention, command and its stop bit going out
+    DATA,           // start bit, data and stop bit of a listen going out
+    SRQ,            // a device holds the stop bit low to request service
+    TLT,            // waiting for the start bit of the device
+    RECV,           // start bit and data bits coming in
+    STOP,           // stop bit of the device
+    STOP_HI,        // the line has to stay high after it
+};
+
+static volatile uint8_t state = IDLE;
+static uint8_t  command;
+static uint16_t command_data;   // for a listen
+
+/* Bits going out MSB first, each is a low then a high part */
+static uint32_t tx_bits;
+static uint8_t  tx_count;
+static bool     tx_low;
+static uint16_t tx_high;
+
+/* Edges coming in */
+static uint8_t  rx_count;
+static uint16_t rx_fall;
+static uint16_t rx_rise;
+static uint16_t rx_data;
+
+/* Results of the last talk to each device, claimed by the next poll */
+static volatile uint16_t result[2];
+static volatile bool     result_ready[2];
+
+/* A listen waiting for the bus */
+static bool     listen_pending = false;
+static uint8_t  listen_cmd;
+static uint16_t listen_data;
+
+
+static void start(uint8_t cmd, uint16_t data)
+{
+    command = cmd;
+    command_data = data;
+    state = COMMAND;
+    // attention, which ends in the low part of the start bit
+    tx_bits = (uint32_t)cmd << 24;      // command, stop bit(0)
+    tx_count = 9;
+    tx_low = true;
+    tx_high = US(65);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        data_lo();
+        OCRA = TCNT + US(800);
+        TIFR = (1<<OCFA);
+        TIMSK |= (1<<OCIEA);
+    }
+}
+
+static void finish(uint16_t data)
+{
+    TIMSK &= ~((1<<OCIEA) | (1<<OCIEB) | (1<<ICIE));
+    if ((command & 0x0C) == 0x0C) {
+        uint8_t i = ((command & 0xF0) == ADDR_MOUSE);
+        result[i] = data;
+        result_ready[i] = true;
+    }
+    state = IDLE;
+}
+
+/* Waits for an edge, at most ticks after from */
+static void expect(bool rising, uint16_t from, uint16_t ticks)
+{
+    if (rising)
+        TCCRB |=  (1<<ICES);
+    else
+        TCCRB &= ~(1<<ICES);
+    // changing the edge may set the flag
+    TIFR = (1<<ICF) | (1<<OCFB);
+    OCRB = from + ticks;
+    TIMSK |= (1<<ICIE) | (1<<OCIEB);
+}
+
+static void sent(void)
+{
+    uint16_t now = OCRA;
+    if (state == COMMAND && (command & 0x0C) == 0x08) {
+        // Tlt(200us) then start bit(1), data and stop bit(0)
+        state = DATA;
+        tx_bits = (1UL<<31) | ((uint32_t)command_data << 15);
+        tx_count = 18;
+        OCRA = now + US(200);
+        return;
+    }
+    if (state == COMMAND && (command & 0x0C) == 0x0C) {
+        TIMSK &= ~(1<<OCIEA);
+        if (!data_in()) {
+            state = SRQ;        // Service Request(310us Adjustable Keyboard): just ignored
+            expect(true, now, US(500));
+        } else {
+            state = TLT;        // Tlt/Stop to Start(140-260us)
+            expect(false, now, US(500));
+        }
+        return;
+    }
+    finish(0);
+}
+
+ISR(TIMER_VECT(ADB_TIMER, COMPA))
+{
+    if (tx_low) {
+        data_hi();
+        tx_low = false;
+        OCRA += tx_high;
+        return;
+    }
+    if (!tx_count) {
+        sent();
+        return;
+    }
+    bool bit = tx_bits & (1UL<<31);
+    tx_bits <<= 1;
+    tx_count--;
+    data_lo();
+    tx_low = true;
+    OCRA += bit ? US(35) : US(65);
+    tx_high = bit ? US(65) : US(35);
+}
+
+ISR(TIMER_VECT(ADB_TIMER, CAPT))
+{
+    uint16_t t = ICR;
+    bool rising = TCCRB & (1<<ICES);
+
+    switch (state) {
+        case SRQ:
+            state = TLT;
+            expect(false, t, US(500));
+            break;
+        case TLT:
+            state = RECV;
+            rx_count = 0;
+            rx_data = 0;
+            rx_fall = t;
+            expect(true, t, US(130));
+            break;
+        case RECV:
+            if (rising) {
+                rx_rise = t;
+                expect(false, rx_fall, US(130));
+                break;
+            }
+            // the cell ended, a bit is 1 when its low part is the shorter
+            {
+                bool bit = (uint16_t)(rx_rise - rx_fall) < (uint16_t)(t - rx_rise);
+                if (rx_count == 0 && !bit) {
+                    finish(-20);
+                    break;
+                }
+                rx_data = (rx_data << 1) | bit;
+                rx_fall = t;
+                // start bit + 16 data bits, this is the stop bit
+                if (++rx_count == 17) {
+                    state = STOP;
+                    expect(true, t, US(351));
+                } else {
+                    expect(true, t, US(130));
+                }
+            }
+            break;
+        case STOP:
+            state = STOP_HI;
+            expect(false, t, US(91));
+            break;
+        case STOP_HI:
+            finish(-21);
+            break;
+        default:
+            TIMSK &= ~(1<<ICIE);
+    }
+}
+
+ISR(TIMER_VECT(ADB_TIMER, COMPB))
+{
+    switch (state) {
+        case SRQ:
+            finish(-30);        // something wrong
+            break;
+        case TLT:
+            finish(0);          // No data to send
+            break;
+        case RECV:
+            finish(-(17 - rx_count));
+            break;
+        case STOP:
+            finish(-21);
+            break;
+        case STOP_HI:
+            finish(rx_data);
+            break;
+        default:
+            TIMSK &= ~(1<<OCIEB);
+    }
+}
+
+
+void adb_host_init(void)
+{
+    ADB_PORT &= ~(1<<ADB_DATA_BIT);
+    data_hi();
+#ifdef ADB_PSW_BIT
+    psw_hi();
+#endif
+    TCCRA = 0;
+    TCCRB = (1<<ICNC) | (1<<CS1);       // normal mode, noise canceler, clk/8
+    TIMSK &= ~((1<<OCIEA) | (1<<OCIEB) | (1<<ICIE));
+}
+
+#ifdef ADB_PSW_BIT
+bool adb_host_psw(void)
+{
+    return psw_in();
+}
+#endif
+
+/*
+ * Returns what the device sent to the previous call, 0 when it had nothing or
+ * the transaction hasn't finished yet, and starts the next one if the bus is
+ * free. Don't call this in a row without the delay, recommended interval is
+ * 12ms as with adb.c.
+ */
+static uint16_t adb_host_dev_recv(uint8_t device)
+{
+    uint8_t i = (device == ADDR_MOUSE);
+    uint16_t data = 0;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (result_ready[i]) {
+            result_ready[i] = false;
+            data = result[i];
+        }
+    }
+
+    if (state == IDLE) {
+        if (listen_pending) {
+            listen_pending = false;
+            start(listen_cmd, listen_data);
+        } else {
+            start(device|0x0C, 0);     // Addr:Keyboard(0010)/Mouse(0011), Cmd:Talk(11), Register0(00)
+        }
+    }
+    return data;
+}
+
+uint16_t adb_host_kbd_recv(void)
+{
+    return adb_host_dev_recv(ADDR_KEYB);
+}
+
+#ifdef ADB_MOUSE_ENABLE
+void adb_mouse_init(void) {
+    return;
+}
+
+uint16_t adb_host_mouse_recv(void)
+{
+    return adb_host_dev_recv(ADDR_MOUSE);
+}
+#endif
+
+/* Goes out now if the bus is free, otherwise in place of the next talk */
+void adb_host_listen(uint8_t cmd, uint8_t data_h, uint8_t data_l)
+{
+    if (state == IDLE) {
+        start(cmd, (data_h << 8) | data_l);
+    } else {
+        listen_cmd = cmd;
+        listen_data = (data_h << 8) | data_l;
+        listen_pending = true;
+    }
+}
+
+// send state of LEDs
+void adb_host_kbd_led(uint8_t led)
+{
+    // Addr:Keyboard(0010), Cmd:Listen(10), Register2(10)
+    // send upper byte (not used)
+    // send lower byte (bit2: ScrollLock, bit1: CapsLock, bit0:
+    adb_host_listen(0x2A,0,led&0x07);
+}
+
+
+#ifdef ADB_PSW_BIT
+static inline void psw_hi()
+{
+    ADB_PORT |=  (1<<ADB_PSW_BIT);
+    ADB_DDR  &= ~(1<<ADB_PSW_BIT);
+}
+static inline bool psw_in()
+{
+    ADB_PORT |=  (1<<ADB_PSW_BIT);
+    ADB_DDR  &= ~(1<<ADB_PSW_BIT);
+    return ADB_PIN&(1<<ADB_PSW_BIT);
+}
+#endif
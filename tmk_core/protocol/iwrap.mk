@@ -8,6 +8,14 @@ SRC +=	$(IWRAP_DIR)/main.c \
 	$(COMMON_DIR)/sendchar_uart.c \
 	$(COMMON_DIR)/uart.c
 
+# Send to iWRAP from a timer interrupt rather than bit-banging with
+# interrupts off; needs Timer2
+ifneq ($(strip $(SUART_TX_TIMER)), no)
+    OPT_DEFS += -DSUART_TX_TIMER
+    SRC += $(IWRAP_DIR)/suart_tx.c \
+	protocol/serial_tx.c
+endif
+
 # Search Path
 VPATH += $(TMK_DIR)/protocol/iwrap
 
@@ -47,6 +47,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 } while (0)
 #define MUX_FOOTER(LINK) xmit(LINK^0xff)
 
+/* HID raw mode report in a MUX frame on link 1, with data from DATA(Input) on */
+static bool mux_send_report(const uint8_t *data, uint8_t len, uint8_t kind, bool merge)
+{
+    uint8_t frame[4 + 2 + 10 + 1] = { 0xbf, 0x01, 0x00, len + 2, 0x9f, len };
+    memcpy(&frame[6], data, len);
+    frame[6 + len] = 0x01^0xff;
+    return suart_send(frame, len + 7, kind, merge);
+}
+
 
 static uint8_t connected = 0;
 //static uint8_t channel = 1;
@@ -153,12 +162,15 @@ void iwrap_mux_send(const char *s)
     MUX_HEADER(0xff, strlen((char *)s));
     iwrap_send(s);
     MUX_FOOTER(0xff);
+    suart_flush();
 }
 
+/* commands go out before their response comes in, see suart_tx.c */
 void iwrap_send(const char *s)
 {
     while (*s)
         xmit(*s++);
+    suart_flush();
 }
 
 /* send buffer */
@@ -329,40 +341,34 @@ static uint8_t keyboard_leds(void) {
 
 static void send_keyboard(report_keyboard_t *report)
 {
+    // the report queued before the last one, and the last one
+    static report_keyboard_t prev, last;
+
     if (!iwrap_connected() && !iwrap_check_connection()) return;
-    MUX_HEADER(0x01, 0x0c);
-    // HID raw mode header
-    xmit(0x9f);
-    xmit(0x0a); // Length
-    xmit(0xa1); // DATA(Input)
-    xmit(0x01); // Report ID
-    xmit(report->mods);
-    xmit(0x00); // reserved byte(always 0)
-    xmit(report->keys[0]);
-    xmit(report->keys[1]);
-    xmit(report->keys[2]);
-    xmit(report->keys[3]);
-    xmit(report->keys[4]);
-    xmit(report->keys[5]);
-    MUX_FOOTER(0x01);
+    uint8_t data[10] = {
+        0xa1, // DATA(Input)
+        0x01, // Report ID
+        report->mods,
+        0x00, // reserved byte(always 0)
+    };
+    memcpy(&data[4], report->keys, 6);
+    if (!mux_send_report(data, sizeof(data), SERIAL_TX_KEYBOARD,
+                         keyboard_report_mergeable(&prev, &last, report))) {
+        prev = last;
+    }
+    last = *report;
 }
 
 static void send_mouse(report_mouse_t *report)
 {
 #if defined(MOUSEKEY_ENABLE) || defined(PS2_MOUSE_ENABLE)
     if (!iwrap_connected() && !iwrap_check_connection()) return;
-    MUX_HEADER(0x01, 0x09);
-    // HID raw mode header
-    xmit(0x9f);
-    xmit(0x07); // Length
-    xmit(0xa1); // DATA(Input)
-    xmit(0x02); // Report ID
-    xmit(report->buttons);
-    xmit(report->x);
-    xmit(report->y);
-    xmit(report->v);
-    xmit(report->h);
-    MUX_FOOTER(0x01);
+    uint8_t data[] = {
+        0xa1, // DATA(Input)
+        0x02, // Report ID
+        report->buttons, report->x, report->y, report->v, report->h
+    };
+    mux_send_report(data, sizeof(data), SERIAL_TX_STREAM, false);
 #endif
 }
 
@@ -456,14 +462,11 @@ static void send_consumer(uint16_t data)
             break;
     }
 
-    MUX_HEADER(0x01, 0x07);
-    xmit(0x9f);
-    xmit(0x05); // Length
-    xmit(0xa1); // DATA(Input)
-    xmit(0x03); // Report ID
-    xmit(bits1);
-    xmit(bits2);
-    xmit(bits3);
-    MUX_FOOTER(0x01);
+    uint8_t report[] = {
+        0xa1, // DATA(Input)
+        0x03, // Report ID
+        bits1, bits2, bits3
+    };
+    mux_send_report(report, sizeof(report), SERIAL_TX_STREAM, false);
 #endif
 }
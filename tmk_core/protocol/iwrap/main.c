@@ -170,7 +170,7 @@ int main(void)
         keyboard_task();
 #ifdef PROTOCOL_VUSB
         if (host_get_driver() == vusb_driver())
-            vusb_transfer_keyboard();
+            vusb_transfer();
 #endif
         // TODO: depricated
         if (matrix_is_modified() || console()) {
@@ -1,8 +1,26 @@
 #ifndef SUART
 #define SUART
 
+#include <stdint.h>
+#include <stdbool.h>
+#include "serial_tx.h"
+
 void xmit(uint8_t);
 uint8_t rcvr(void);
 uint8_t recv(void);
 
+#ifdef SUART_TX_TIMER
+/* Queues data to be sent from Timer2, see serial_tx_put() */
+bool suart_send(const uint8_t *data, uint8_t len, uint8_t kind, bool merge);
+/* Waits until everything queued is out */
+void suart_flush(void);
+#else
+static inline bool suart_send(const uint8_t *data, uint8_t len, uint8_t kind, bool merge)
+{
+    while (len--) xmit(*data++);
+    return false;
+}
+static inline void suart_flush(void) {}
+#endif
+
 #endif	/* SUART */
@@ -0,0 +1,85 @@
+/*
+ * Soft UART transmitter driven by Timer2
+ *
+ * Replaces the busy-waiting xmit() of suart.S, which kept interrupts off for
+ * a whole byte. Bytes are queued in serial_tx and shifted out one bit per
+ * compare match, so the main loop and V-USB keep running meanwhile.
+ *
+ * The receiver is still the one in suart.S and runs with interrupts off,
+ * so bits sent while a byte comes in are late. Commands to iWRAP wait with
+ * suart_flush() until they are out before its response arrives.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "serial_tx.h"
+#include "suart.h"
+
+/* what suart.S's bit delay of 102 gives at 12MHz */
+#ifndef SUART_BAUD
+#define SUART_BAUD 38400
+#endif
+
+#define SUART_OCR ((F_CPU / 8 + SUART_BAUD / 2) / SUART_BAUD - 1)
+
+#if SUART_OCR > 255
+#error "SUART_BAUD is too low for Timer2 at this F_CPU"
+#endif
+
+#define OUT_1() (SUART_OUT_PORT |= (1<<SUART_OUT_BIT))
+#define OUT_0() (SUART_OUT_PORT &= ~(1<<SUART_OUT_BIT))
+
+static uint16_t shift;      // data bits then the stop bit, LSB first
+static uint8_t bits = 0;    // left in shift
+
+
+static void suart_start(void)
+{
+    if (TIMSK2 & (1<<OCIE2A)) return;
+
+    // CTC, clk/8
+    TCCR2A = (1<<WGM21);
+    TCCR2B = (1<<CS21);
+    OCR2A = SUART_OCR;
+    TCNT2 = 0;
+    TIFR2 = (1<<OCF2A);
+    TIMSK2 |= (1<<OCIE2A);
+}
+
+void xmit(uint8_t data)
+{
+    suart_send(&data, 1, SERIAL_TX_STREAM, false);
+}
+
+bool suart_send(const uint8_t *data, uint8_t len, uint8_t kind, bool merge)
+{
+    bool merged = serial_tx_put(data, len, kind, merge);
+    suart_start();
+    return merged;
+}
+
+void suart_flush(void)
+{
+    while (TIMSK2 & (1<<OCIE2A)) ;
+}
+
+ISR(TIMER2_COMPA_vect)
+{
+    if (bits) {
+        if (shift & 1) OUT_1(); else OUT_0();
+        shift >>= 1;
+        bits--;
+        return;
+    }
+
+    int16_t data = serial_tx_get();
+    if (data < 0) {
+        // the stop bit is out, idle high
+        TIMSK2 &= ~(1<<OCIE2A);
+        return;
+    }
+    OUT_0();    // start bit
+    shift = data | 0x100;
+    bits = 9;
+}
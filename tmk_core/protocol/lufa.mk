@@ -27,7 +27,13 @@ endif
 
 ifeq ($(strip $(BLUETOOTH_ENABLE)), yes)
 	LUFA_SRC += $(LUFA_DIR)/bluetooth.c \
-	$(TMK_DIR)/protocol/serial_uart.c
+	$(TMK_DIR)/protocol/serial_uart.c \
+	$(TMK_DIR)/protocol/serial_tx.c
+endif
+
+ifeq ($(strip $(SOF_SYNC_ENABLE)), yes)
+	LUFA_SRC += $(LUFA_DIR)/sof_sync.c
+	OPT_DEFS += -DSOF_SYNC_ENABLE
 endif
 
 ifeq ($(strip $(VIRTSER_ENABLE)), yes)
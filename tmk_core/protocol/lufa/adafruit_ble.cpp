@@ -4,10 +4,12 @@
 #include <alloca.h>
 #include <util/delay.h>
 #include <util/atomic.h>
+#include <avr/interrupt.h>
 #include "debug.h"
 #include "pincontrol.h"
 #include "timer.h"
 #include "action_util.h"
+#include "report.h"
 #include "ringbuffer.hpp"
 #include <string.h>
 
@@ -26,6 +28,11 @@
 #define AdafruitBleIRQPin   E6
 #endif
 
+// The external interrupt on AdafruitBleIRQPin; E6 is INT6
+#ifndef AdafruitBleIRQInt
+#define AdafruitBleIRQInt   6
+#endif
+
 
 #define SAMPLE_BATTERY
 #define ConnectionUpdateInterval 1000 /* milliseconds */
@@ -44,8 +51,64 @@ static struct {
   uint32_t vbat;
 #endif
   uint16_t last_connection_update;
+  uint16_t retry_after;     // a send failed; don't try again before this
 } state;
 
+// Set from the IRQ line, so the task only talks to the module when the
+// module has something to say
+static volatile bool irq_pending;
+static volatile uint16_t irq_time;
+
+#define _BLE_IRQ_VECT(n) INT ## n ## _vect
+#define BLE_IRQ_VECT(n) _BLE_IRQ_VECT(n)
+
+ISR(BLE_IRQ_VECT(AdafruitBleIRQInt)) {
+  irq_time = timer_read();
+  irq_pending = true;
+}
+
+// The module keeps the line high while it has more to say, which makes no
+// new edge; take that as pending too
+static void irq_recheck(void) {
+  if (digitalRead(AdafruitBleIRQPin)) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      if (!irq_pending) {
+        irq_time = timer_read();
+        irq_pending = true;
+      }
+    }
+  }
+}
+
+static void irq_init(void) {
+  // rising edge
+#if AdafruitBleIRQInt < 4
+  EICRA |= (_BV(ISC00) | _BV(ISC01)) << (2 * AdafruitBleIRQInt);
+#else
+  EICRB |= (_BV(ISC40) | _BV(ISC41)) << (2 * (AdafruitBleIRQInt - 4));
+#endif
+  EIFR = _BV(AdafruitBleIRQInt);
+  EIMSK |= _BV(AdafruitBleIRQInt);
+  irq_recheck();
+}
+
+// Latency histograms in log2(ms) buckets: 0, 1, 2-3, 4-7, ... 64 and up
+#define LatencyBuckets 8
+static struct {
+  uint16_t queued[LatencyBuckets];   // from the report to its command
+  uint16_t response[LatencyBuckets]; // from the command to its response
+  uint16_t coalesced;
+} stats;
+
+static void latency_add(uint16_t *histogram, uint16_t ms) {
+  uint8_t bucket = 0;
+  while (ms && bucket < LatencyBuckets - 1) {
+    ms >>= 1;
+    ++bucket;
+  }
+  ++histogram[bucket];
+}
+
 // Commands are encoded using SDEP and sent via SPI
 // https://github.com/adafruit/Adafruit_BluefruitLE_nRF51/blob/master/SDEP.md
 
@@ -92,11 +155,11 @@ struct queue_item {
 };
 
 // Items that we wish to send
-static RingBuffer<queue_item, 40> send_buf;
+static RingBuffer<queue_item, 32> send_buf;
 // Pending response; while pending, we can't send any more requests.
 // This records the time at which we sent the command for which we
 // are expecting a response.
-static RingBuffer<uint16_t, 2> resp_buf;
+static RingBuffer<uint16_t, 1> resp_buf;
 
 static bool process_queue_item(struct queue_item *item, uint16_t timeout);
 
@@ -319,21 +382,27 @@ static void resp_buf_read_one(bool greedy) {
     return;
   }
 
-  if (digitalRead(AdafruitBleIRQPin)) {
+  if (irq_pending) {
     struct sdep_msg msg;
 
 again:
+    uint16_t arrived = irq_time;
+    irq_pending = false;
     if (sdep_recv_pkt(&msg, SdepTimeout)) {
       if (!msg.more) {
         // We got it; consume this entry
         resp_buf.get(last_send);
-        dprintf("recv latency %dms\n", TIMER_DIFF_16(timer_read(), last_send));
+        latency_add(stats.response, TIMER_DIFF_16(arrived, last_send));
       }
 
-      if (greedy && resp_buf.peek(last_send) && digitalRead(AdafruitBleIRQPin)) {
-        goto again;
+      if (greedy && resp_buf.peek(last_send)) {
+        irq_recheck();
+        if (irq_pending) {
+          goto again;
+        }
       }
     }
+    irq_recheck();
 
   } else if (timer_elapsed(last_send) > SdepTimeout * 2) {
     dprintf("waiting_for_result: timeout, resp_buf size %d\n",
@@ -352,17 +421,19 @@ static void send_buf_send_one(uint16_t timeout = SdepTimeout) {
     return;
   }
 
-  if (!send_buf.peek(item)) {
+  if (state.retry_after && timer_elapsed(state.retry_after) > SdepTimeout) {
+    state.retry_after = 0;
+  }
+  if (state.retry_after || !send_buf.peek(item)) {
     return;
   }
   if (process_queue_item(&item, timeout)) {
     // commit that peek
     send_buf.get(item);
-    dprintf("send_buf_send_one: have %d remaining\n", (int)send_buf.size());
+    latency_add(stats.queued, TIMER_DIFF_16(timer_read(), item.added));
   } else {
     dprint("failed to send, will retry\n");
-    _delay_ms(SdepTimeout);
-    resp_buf_read_one(true);
+    state.retry_after = timer_read() | 1;
   }
 }
 
@@ -385,6 +456,7 @@ static bool ble_init(void) {
   pinMode(AdafruitBleIRQPin, PinDirectionInput);
   pinMode(AdafruitBleCSPin, PinDirectionOutput);
   digitalWrite(AdafruitBleCSPin, PinLevelHigh);
+  irq_init();
 
   SPI_init(&spi);
 
@@ -608,8 +680,8 @@ void adafruit_ble_task(void) {
   resp_buf_read_one(true);
   send_buf_send_one(SdepShortTimeout);
 
-  if (resp_buf.empty() && (state.event_flags & UsingEvents) &&
-      digitalRead(AdafruitBleIRQPin)) {
+  if (resp_buf.empty() && (state.event_flags & UsingEvents) && irq_pending) {
+    irq_pending = false;
     // Must be an event update
     if (at_command_P(PSTR("AT+EVENTSTATUS"), resbuf, sizeof(resbuf))) {
       uint32_t mask = strtoul(resbuf, NULL, 16);
@@ -622,8 +694,10 @@ void adafruit_ble_task(void) {
     }
   }
 
-  if (timer_elapsed(state.last_connection_update) > ConnectionUpdateInterval) {
-    bool shouldPoll = true;
+  // Once the module reports connection changes as events, there is nothing
+  // left to poll for
+  if (!(state.event_flags & UsingEvents) &&
+      timer_elapsed(state.last_connection_update) > ConnectionUpdateInterval) {
     if (!(state.event_flags & ProbedEvents)) {
       // Request notifications about connection status changes.
       // This only works in SPIFRIEND firmware > 0.6.7, which is why
@@ -636,11 +710,6 @@ void adafruit_ble_task(void) {
         state.event_flags |= UsingEvents;
       }
       state.event_flags |= ProbedEvents;
-
-      // leave shouldPoll == true so that we check at least once
-      // before relying solely on events
-    } else {
-      shouldPoll = false;
     }
 
     static const char kGetConn[] PROGMEM = "AT+GAPGETCONN";
@@ -666,6 +735,35 @@ void adafruit_ble_task(void) {
 #endif
 }
 
+static char *hex_byte(char *dest, uint8_t b) {
+  static const char digits[] PROGMEM = "0123456789abcdef";
+  *dest++ = pgm_read_byte(&digits[b >> 4]);
+  *dest++ = pgm_read_byte(&digits[b & 0xf]);
+  return dest;
+}
+
+/* The key report as an AT command, without going through a format string.
+ * Trailing empty slots are left out, which saves an SDEP packet for most
+ * reports. */
+static void encode_key_report(char *cmd, const struct queue_item *item) {
+  static const char prefix[] PROGMEM = "AT+BLEKEYBOARDCODE=";
+  strcpy_P(cmd, prefix);
+  char *dest = cmd + sizeof(prefix) - 1;
+
+  uint8_t nkeys = sizeof(item->key.keys);
+  while (nkeys && !item->key.keys[nkeys - 1]) {
+    --nkeys;
+  }
+  dest = hex_byte(dest, item->key.modifier);
+  *dest++ = '-';
+  dest = hex_byte(dest, 0);
+  for (uint8_t i = 0; i < nkeys; ++i) {
+    *dest++ = '-';
+    dest = hex_byte(dest, item->key.keys[i]);
+  }
+  *dest = 0;
+}
+
 static bool process_queue_item(struct queue_item *item, uint16_t timeout) {
   char cmdbuf[48];
   char fmtbuf[64];
@@ -673,20 +771,9 @@ static bool process_queue_item(struct queue_item *item, uint16_t timeout) {
   // Arrange to re-check connection after keys have settled
   state.last_connection_update = timer_read();
 
-#if 1
-  if (TIMER_DIFF_16(state.last_connection_update, item->added) > 0) {
-    dprintf("send latency %dms\n",
-            TIMER_DIFF_16(state.last_connection_update, item->added));
-  }
-#endif
-
   switch (item->queue_type) {
     case QTKeyReport:
-      strcpy_P(fmtbuf,
-          PSTR("AT+BLEKEYBOARDCODE=%02x-00-%02x-%02x-%02x-%02x-%02x-%02x"));
-      snprintf(cmdbuf, sizeof(cmdbuf), fmtbuf, item->key.modifier,
-               item->key.keys[0], item->key.keys[1], item->key.keys[2],
-               item->key.keys[3], item->key.keys[4], item->key.keys[5]);
+      encode_key_report(cmdbuf, item);
       return at_command(cmdbuf, NULL, 0, true, timeout);
 
     case QTConsumer:
@@ -706,6 +793,68 @@ static bool process_queue_item(struct queue_item *item, uint16_t timeout) {
   }
 }
 
+// The last key report queued and the one before it, which the host has
+// seen by the time the last one arrives
+static report_keyboard_t key_prev, key_last;
+
+static void key_report(report_keyboard_t *report, const struct queue_item *item) {
+  memset(report, 0, sizeof(*report));
+  report->mods = item->key.modifier;
+  memcpy(report->keys, item->key.keys, sizeof(item->key.keys));
+}
+
+/* The module takes one command per round trip, which is about a
+ * connection interval. While one is on its way, a queued report can take
+ * the next one in its place, as long as nothing in it gets lost: see
+ * keyboard_report_mergeable() for key reports, mouse moves still have to
+ * fit. */
+static bool coalesce(const struct queue_item *item) {
+  if (send_buf.empty()) {
+    return false;
+  }
+  struct queue_item &last = send_buf.back();
+  if (last.queue_type != item->queue_type) {
+    return false;
+  }
+
+  switch (item->queue_type) {
+    case QTKeyReport: {
+      report_keyboard_t next;
+      key_report(&next, item);
+      if (!keyboard_report_mergeable(&key_prev, &key_last, &next)) {
+        return false;
+      }
+      // keep the time of the older one, it has waited since then
+      memcpy(&last.key, &item->key, sizeof(last.key));
+      key_last = next;
+      break;
+    }
+
+#ifdef MOUSE_ENABLE
+    case QTMouseMove: {
+      int16_t x = last.mousemove.x + item->mousemove.x;
+      int16_t y = last.mousemove.y + item->mousemove.y;
+      int16_t scroll = last.mousemove.scroll + item->mousemove.scroll;
+      int16_t pan = last.mousemove.pan + item->mousemove.pan;
+      if (x < -127 || x > 127 || y < -127 || y > 127 || scroll < -127 ||
+          scroll > 127 || pan < -127 || pan > 127) {
+        return false;
+      }
+      last.mousemove.x = x;
+      last.mousemove.y = y;
+      last.mousemove.scroll = scroll;
+      last.mousemove.pan = pan;
+      break;
+    }
+#endif
+
+    default:
+      return false;
+  }
+  ++stats.coalesced;
+  return true;
+}
+
 bool adafruit_ble_send_keys(uint8_t hid_modifier_mask, uint8_t *keys,
                             uint8_t nkeys) {
   struct queue_item item;
@@ -723,6 +872,9 @@ bool adafruit_ble_send_keys(uint8_t hid_modifier_mask, uint8_t *keys,
     item.key.keys[4] = nkeys >= 4 ? keys[4] : 0;
     item.key.keys[5] = nkeys >= 5 ? keys[5] : 0;
 
+    if (nkeys <= 6 && coalesce(&item)) {
+      return true;
+    }
     if (!send_buf.enqueue(item)) {
       if (!didWait) {
         dprint("wait for buf space\n");
@@ -731,6 +883,8 @@ bool adafruit_ble_send_keys(uint8_t hid_modifier_mask, uint8_t *keys,
       send_buf_send_one();
       continue;
     }
+    key_prev = key_last;
+    key_report(&key_last, &item);
 
     if (nkeys <= 6) {
       return true;
@@ -748,6 +902,7 @@ bool adafruit_ble_send_consumer_key(uint16_t keycode, int hold_duration) {
 
   item.queue_type = QTConsumer;
   item.consumer = keycode;
+  item.added = timer_read();
 
   while (!send_buf.enqueue(item)) {
     send_buf_send_one();
@@ -765,7 +920,11 @@ bool adafruit_ble_send_mouse_move(int8_t x, int8_t y, int8_t scroll,
   item.mousemove.y = y;
   item.mousemove.scroll = scroll;
   item.mousemove.pan = pan;
+  item.added = timer_read();
 
+  if (coalesce(&item)) {
+    return true;
+  }
   while (!send_buf.enqueue(item)) {
     send_buf_send_one();
   }
@@ -773,6 +932,22 @@ bool adafruit_ble_send_mouse_move(int8_t x, int8_t y, int8_t scroll,
 }
 #endif
 
+static void print_histogram(const uint16_t *histogram) {
+  for (uint8_t i = 0; i < LatencyBuckets; ++i) {
+    xprintf(" %u", histogram[i]);
+  }
+  print("\n");
+}
+
+void adafruit_ble_print_stats(void) {
+  print("BLE latency, ms: 0 1 2-3 4-7 8-15 16-31 32-63 64+\n");
+  print("queued:");
+  print_histogram(stats.queued);
+  print("response:");
+  print_histogram(stats.response);
+  xprintf("coalesced: %u\n", stats.coalesced);
+}
+
 uint32_t adafruit_ble_read_battery_voltage(void) {
   return state.vbat;
 }
@@ -50,6 +50,9 @@ extern bool adafruit_ble_send_mouse_move(int8_t x, int8_t y, int8_t scroll,
  * Returns the integer number of millivolts */
 extern uint32_t adafruit_ble_read_battery_voltage(void);
 
+/* Prints the latency histograms of the report path to the console */
+extern void adafruit_ble_print_stats(void);
+
 extern bool adafruit_ble_set_mode_leds(bool on);
 extern bool adafruit_ble_set_power_level(int8_t level);
 
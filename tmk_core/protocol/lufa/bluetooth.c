@@ -33,4 +33,9 @@ void bluefruit_keyboard_print_report(report_keyboard_t *report)
 void bluefruit_serial_send(uint8_t data)
 {
     serial_send(data);
+}
+
+bool bluefruit_serial_send_frame(const uint8_t *data, uint8_t len, uint8_t kind, bool merge)
+{
+    return serial_send_frame(data, len, kind, merge);
 }
\ No newline at end of file
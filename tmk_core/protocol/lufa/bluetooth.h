@@ -21,6 +21,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "../serial.h"
 
 void bluefruit_serial_send(uint8_t data);
+/* Queues a whole report, see serial_tx_put() */
+bool bluefruit_serial_send_frame(const uint8_t *data, uint8_t len, uint8_t kind, bool merge);
 
 /*
 +-----------------+-------------------+-------+
@@ -88,6 +88,10 @@
 	#include "raw_hid.h"
 #endif
 
+#ifdef SOF_SYNC_ENABLE
+    #include "sof_sync.h"
+#endif
+
 uint8_t keyboard_idle = 0;
 /* 0: Boot Protocol, 1: Report Protocol(default) */
 uint8_t keyboard_protocol = 1;
@@ -97,6 +101,7 @@ static report_keyboard_t keyboard_report_sent;
 
 #ifdef MIDI_ENABLE
 static void usb_send_func(MidiDevice * device, uint16_t cnt, uint8_t byte0, uint8_t byte1, uint8_t byte2);
+static void usb_send_sysex_func(MidiDevice * device, uint16_t count, uint8_t * array);
 static void usb_get_midi(MidiDevice * device);
 static void midi_usb_init(MidiDevice * device);
 #endif
@@ -316,6 +321,177 @@ static void Console_Task(void)
 #endif
 
 
+/*******************************************************************************
+ * Report queues
+ *
+ * Reports wait in a small queue per endpoint and are written once the
+ * endpoint bank is free, right away if it already is, otherwise at the next
+ * start of frame. Only a full queue waits for the host, when the newest
+ * report can't take the place of the last one queued.
+ ******************************************************************************/
+lufa_report_stats_t lufa_report_stats;
+
+// replacing the last report looks at the one before it
+_Static_assert(REPORT_QUEUE_SIZE >= 2, "REPORT_QUEUE_SIZE must be at least 2");
+
+typedef struct {
+    uint8_t ep;
+    uint8_t size;       // bytes per report
+    uint8_t head;
+    uint8_t count;
+    uint8_t *reports;   // REPORT_QUEUE_SIZE * size
+    void *sent;         // gets a copy of every report written, or NULL
+    // true if next can overwrite last, which follows prev; NULL for never
+    bool (*replaceable)(const uint8_t *prev, const uint8_t *last, const uint8_t *next);
+} report_queue_t;
+
+static void boot_report(report_keyboard_t *report, const uint8_t *raw)
+{
+    memset(report, 0, sizeof(*report));
+    memcpy(report->raw, raw, KEYBOARD_EPSIZE);
+}
+
+static bool boot_replaceable(const uint8_t *prev, const uint8_t *last, const uint8_t *next)
+{
+    report_keyboard_t p, l, n;
+    boot_report(&p, prev);
+    boot_report(&l, last);
+    boot_report(&n, next);
+    return keyboard_report_mergeable(&p, &l, &n);
+}
+
+static uint8_t keyboard_reports[REPORT_QUEUE_SIZE][KEYBOARD_EPSIZE];
+static report_queue_t keyboard_queue = {
+    KEYBOARD_IN_EPNUM, KEYBOARD_EPSIZE, 0, 0, keyboard_reports[0], &keyboard_report_sent, boot_replaceable
+};
+#ifdef NKRO_ENABLE
+static uint8_t nkro_reports[REPORT_QUEUE_SIZE][NKRO_EPSIZE];
+static report_queue_t nkro_queue = {
+    NKRO_IN_EPNUM, NKRO_EPSIZE, 0, 0, nkro_reports[0], &keyboard_report_sent, NULL
+};
+#endif
+#ifdef MOUSE_ENABLE
+static report_mouse_t mouse_reports[REPORT_QUEUE_SIZE];
+static report_queue_t mouse_queue = {
+    MOUSE_IN_EPNUM, sizeof(report_mouse_t), 0, 0, (uint8_t *)mouse_reports, NULL, NULL
+};
+#endif
+#ifdef EXTRAKEY_ENABLE
+static report_extra_t extra_reports[REPORT_QUEUE_SIZE];
+static report_queue_t extra_queue = {
+    EXTRAKEY_IN_EPNUM, sizeof(report_extra_t), 0, 0, (uint8_t *)extra_reports, NULL, NULL
+};
+#endif
+
+static report_queue_t * const report_queues[] = {
+    &keyboard_queue,
+#ifdef NKRO_ENABLE
+    &nkro_queue,
+#endif
+#ifdef MOUSE_ENABLE
+    &mouse_queue,
+#endif
+#ifdef EXTRAKEY_ENABLE
+    &extra_queue,
+#endif
+};
+
+static inline uint8_t *queue_at(report_queue_t *q, uint8_t i)
+{
+    return q->reports + ((q->head + i) % REPORT_QUEUE_SIZE) * q->size;
+}
+
+static inline uint8_t *queue_tail(report_queue_t *q)
+{
+    return q->count ? queue_at(q, q->count - 1) : NULL;
+}
+
+/* Interrupts have to be off, the start of frame handler flushes too.
+ * A full queue takes the report in place of the last one only if no
+ * transition gets lost that way, or when `force` is set; otherwise it
+ * returns false and the caller has to come back after a frame. */
+static bool queue_push(report_queue_t *q, const void *report, bool force)
+{
+    uint8_t *tail = queue_tail(q);
+    if (tail ? !memcmp(tail, report, q->size)
+             : (q->sent && !memcmp(q->sent, report, q->size))) {
+        lufa_report_stats.merged++;
+        return true;
+    }
+    if (q->count == REPORT_QUEUE_SIZE) {
+        if (q->replaceable && q->replaceable(queue_at(q, q->count - 2), tail, report)) {
+            memcpy(tail, report, q->size);
+            lufa_report_stats.merged++;
+            return true;
+        }
+        if (!force) return false;
+        memcpy(tail, report, q->size);
+        lufa_report_stats.dropped++;
+        return true;
+    }
+    memcpy(queue_at(q, q->count++), report, q->size);
+    lufa_report_stats.queued++;
+    return true;
+}
+
+/* A full queue drains at every start of frame. Waiting for that is given
+ * up after REPORT_QUEUE_TIMEOUT ms and right away when the host isn't
+ * polling at all, so a suspended host doesn't stall the keyboard. */
+static bool queue_give_up(uint16_t start)
+{
+    return USB_DeviceState != DEVICE_STATE_Configured ||
+           timer_elapsed(start) >= REPORT_QUEUE_TIMEOUT;
+}
+
+/* Writes the oldest report if the endpoint bank is free */
+static void queue_flush(report_queue_t *q)
+{
+    if (!q->count) return;
+
+    Endpoint_SelectEndpoint(q->ep);
+    if (!Endpoint_IsReadWriteAllowed()) return;
+
+    uint8_t *report = queue_at(q, 0);
+    Endpoint_Write_Stream_LE(report, q->size, NULL);
+    Endpoint_ClearIN();
+    if (q->sent) {
+        memcpy(q->sent, report, q->size);
+    }
+    q->head = (q->head + 1) % REPORT_QUEUE_SIZE;
+    q->count--;
+}
+
+static void report_queues_flush(void)
+{
+    if (USB_DeviceState != DEVICE_STATE_Configured) return;
+
+    uint8_t ep = Endpoint_GetCurrentEndpoint();
+    for (uint8_t i = 0; i < sizeof(report_queues) / sizeof(report_queues[0]); i++) {
+        queue_flush(report_queues[i]);
+    }
+    Endpoint_SelectEndpoint(ep);
+}
+
+static void report_queues_clear(void)
+{
+    for (uint8_t i = 0; i < sizeof(report_queues) / sizeof(report_queues[0]); i++) {
+        report_queues[i]->count = 0;
+    }
+}
+
+static void report_queue_send(report_queue_t *q, const void *report)
+{
+    uint16_t start = timer_read();
+    bool done = false;
+    while (!done) {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            done = queue_push(q, report, queue_give_up(start));
+            report_queues_flush();
+        }
+    }
+}
+
+
 /*******************************************************************************
  * USB Events
  ******************************************************************************/
@@ -354,6 +530,7 @@ void EVENT_USB_Device_Disconnect(void)
 void EVENT_USB_Device_Reset(void)
 {
     print("[R]");
+    report_queues_clear();
 }
 
 void EVENT_USB_Device_Suspend()
@@ -385,10 +562,17 @@ static bool console_flush = false;
     console_flush = b; \
   } \
 } while (0)
+#endif
 
 // called every 1ms
 void EVENT_USB_Device_StartOfFrame(void)
 {
+#ifdef SOF_SYNC_ENABLE
+    sof_sync_frame();
+#endif
+    report_queues_flush();
+
+#ifdef CONSOLE_ENABLE
     static uint8_t count;
     if (++count % 50) return;
     count = 0;
@@ -396,9 +580,8 @@ void EVENT_USB_Device_StartOfFrame(void)
     if (!console_flush) return;
     Console_Task();
     console_flush = false;
-}
-
 #endif
+}
 
 /** Event handler for the USB_ConfigurationChanged event.
  * This is fired when the host sets the current configuration of the USB device after enumeration.
@@ -410,6 +593,8 @@ void EVENT_USB_Device_ConfigurationChanged(void)
 {
     bool ConfigSuccess = true;
 
+    report_queues_clear();
+
     /* Setup Keyboard HID Report Endpoints */
     ConfigSuccess &= ENDPOINT_CONFIG(KEYBOARD_IN_EPNUM, EP_TYPE_INTERRUPT, ENDPOINT_DIR_IN,
                                      KEYBOARD_EPSIZE, ENDPOINT_BANK_SINGLE);
@@ -626,13 +811,17 @@ static inline uint8_t where_to_send(void) {
 static void send_keyboard(report_keyboard_t *report)
 {
 #ifdef BLUETOOTH_ENABLE
-    bluefruit_serial_send(0xFD);
-    for (uint8_t i = 0; i < KEYBOARD_EPSIZE; i++) {
-        bluefruit_serial_send(report->raw[i]);
+    // the report queued before the last one, and the last one
+    static report_keyboard_t bt_prev, bt_last;
+    uint8_t frame[1 + KEYBOARD_EPSIZE] = { 0xFD };
+    memcpy(&frame[1], report->raw, KEYBOARD_EPSIZE);
+    if (!bluefruit_serial_send_frame(frame, sizeof(frame), SERIAL_TX_KEYBOARD,
+                                     keyboard_report_mergeable(&bt_prev, &bt_last, report))) {
+        bt_prev = bt_last;
     }
+    bt_last = *report;
 #endif
 
-    uint8_t timeout = 255;
     uint8_t where = where_to_send();
 
 #ifdef ADAFRUIT_BLE_ENABLE
@@ -645,57 +834,56 @@ static void send_keyboard(report_keyboard_t *report)
       return;
     }
 
-    /* Select the Keyboard Report Endpoint */
 #ifdef NKRO_ENABLE
     if (keyboard_protocol && keymap_config.nkro) {
         /* Report protocol - NKRO */
-        Endpoint_SelectEndpoint(NKRO_IN_EPNUM);
-
-        /* Check if write ready for a polling interval around 1ms */
-        while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(4);
-        if (!Endpoint_IsReadWriteAllowed()) return;
-
-        /* Write Keyboard Report Data */
-        Endpoint_Write_Stream_LE(report, NKRO_EPSIZE, NULL);
+        report_queue_send(&nkro_queue, report);
     }
     else
 #endif
     {
         /* Boot protocol */
-        Endpoint_SelectEndpoint(KEYBOARD_IN_EPNUM);
-
-        /* Check if write ready for a polling interval around 10ms */
-        while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(40);
-        if (!Endpoint_IsReadWriteAllowed()) return;
-
-        /* Write Keyboard Report Data */
-        Endpoint_Write_Stream_LE(report, KEYBOARD_EPSIZE, NULL);
+        report_queue_send(&keyboard_queue, report);
     }
+}
 
-    /* Finalize the stream transfer to send the last packet */
-    Endpoint_ClearIN();
+#ifdef MOUSE_ENABLE
+static bool mouse_axis_merge(int8_t *to, int8_t delta)
+{
+    int16_t sum = *to + delta;
+    if (sum < -127 || sum > 127) return false;
+    *to = sum;
+    return true;
+}
 
-    keyboard_report_sent = *report;
+/* Adds the motion of `report` to `to`, unless an axis would overflow */
+static bool mouse_merge(report_mouse_t *to, const report_mouse_t *report)
+{
+    report_mouse_t m = *to;
+    if (!mouse_axis_merge(&m.x, report->x) || !mouse_axis_merge(&m.y, report->y) ||
+            !mouse_axis_merge(&m.v, report->v) || !mouse_axis_merge(&m.h, report->h)) {
+        return false;
+    }
+    *to = m;
+    return true;
 }
+#endif
 
 static void send_mouse(report_mouse_t *report)
 {
 #ifdef MOUSE_ENABLE
 
 #ifdef BLUETOOTH_ENABLE
-    bluefruit_serial_send(0xFD);
-    bluefruit_serial_send(0x00);
-    bluefruit_serial_send(0x03);
-    bluefruit_serial_send(report->buttons);
-    bluefruit_serial_send(report->x);
-    bluefruit_serial_send(report->y);
-    bluefruit_serial_send(report->v); // should try sending the wheel v here
-    bluefruit_serial_send(report->h); // should try sending the wheel h here
-    bluefruit_serial_send(0x00);
+    // motion is relative, so mouse reports are never replaced
+    uint8_t frame[] = {
+        0xFD, 0x00, 0x03, report->buttons, report->x, report->y,
+        report->v, // should try sending the wheel v here
+        report->h, // should try sending the wheel h here
+        0x00
+    };
+    bluefruit_serial_send_frame(frame, sizeof(frame), SERIAL_TX_STREAM, false);
 #endif
 
-    uint8_t timeout = 255;
-
     uint8_t where = where_to_send();
 
 #ifdef ADAFRUIT_BLE_ENABLE
@@ -708,25 +896,27 @@ static void send_mouse(report_mouse_t *report)
       return;
     }
 
-    /* Select the Mouse Report Endpoint */
-    Endpoint_SelectEndpoint(MOUSE_IN_EPNUM);
-
-    /* Check if write ready for a polling interval around 10ms */
-    while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(40);
-    if (!Endpoint_IsReadWriteAllowed()) return;
-
-    /* Write Mouse Report Data */
-    Endpoint_Write_Stream_LE(report, sizeof(report_mouse_t), NULL);
-
-    /* Finalize the stream transfer to send the last packet */
-    Endpoint_ClearIN();
+    uint16_t start = timer_read();
+    bool done = false;
+    while (!done) {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            /* Motion adds up, so a queued report with the same buttons takes it */
+            report_mouse_t *tail = (report_mouse_t *)queue_tail(&mouse_queue);
+            if (tail && tail->buttons == report->buttons && mouse_merge(tail, report)) {
+                lufa_report_stats.merged++;
+                done = true;
+            } else {
+                done = queue_push(&mouse_queue, report, queue_give_up(start));
+            }
+            report_queues_flush();
+        }
+    }
 #endif
 }
 
 static void send_system(uint16_t data)
 {
-    uint8_t timeout = 255;
-
+#ifdef EXTRAKEY_ENABLE
     if (USB_DeviceState != DEVICE_STATE_Configured)
         return;
 
@@ -734,14 +924,8 @@ static void send_system(uint16_t data)
         .report_id = REPORT_ID_SYSTEM,
         .usage = data - SYSTEM_POWER_DOWN + 1
     };
-    Endpoint_SelectEndpoint(EXTRAKEY_IN_EPNUM);
-
-    /* Check if write ready for a polling interval around 10ms */
-    while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(40);
-    if (!Endpoint_IsReadWriteAllowed()) return;
-
-    Endpoint_Write_Stream_LE(&r, sizeof(report_extra_t), NULL);
-    Endpoint_ClearIN();
+    report_queue_send(&extra_queue, &r);
+#endif
 }
 
 static void send_consumer(uint16_t data)
@@ -752,18 +936,12 @@ static void send_consumer(uint16_t data)
     if (data == last_data) return;
     last_data = data;
     uint16_t bitmap = CONSUMER2BLUEFRUIT(data);
-    bluefruit_serial_send(0xFD);
-    bluefruit_serial_send(0x00);
-    bluefruit_serial_send(0x02);
-    bluefruit_serial_send((bitmap>>8)&0xFF);
-    bluefruit_serial_send(bitmap&0xFF);
-    bluefruit_serial_send(0x00);
-    bluefruit_serial_send(0x00);
-    bluefruit_serial_send(0x00);
-    bluefruit_serial_send(0x00);
-#endif
-
-    uint8_t timeout = 255;
+    uint8_t frame[] = {
+        0xFD, 0x00, 0x02, (bitmap>>8)&0xFF, bitmap&0xFF, 0x00, 0x00, 0x00, 0x00
+    };
+    bluefruit_serial_send_frame(frame, sizeof(frame), SERIAL_TX_STREAM, false);
+#endif
+
     uint8_t where = where_to_send();
 
 #ifdef ADAFRUIT_BLE_ENABLE
@@ -775,18 +953,13 @@ static void send_consumer(uint16_t data)
       return;
     }
 
+#ifdef EXTRAKEY_ENABLE
     report_extra_t r = {
         .report_id = REPORT_ID_CONSUMER,
         .usage = data
     };
-    Endpoint_SelectEndpoint(EXTRAKEY_IN_EPNUM);
-
-    /* Check if write ready for a polling interval around 10ms */
-    while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(40);
-    if (!Endpoint_IsReadWriteAllowed()) return;
-
-    Endpoint_Write_Stream_LE(&r, sizeof(report_extra_t), NULL);
-    Endpoint_ClearIN();
+    report_queue_send(&extra_queue, &r);
+#endif
 }
 
 
@@ -914,40 +1087,47 @@ static void usb_send_func(MidiDevice * device, uint16_t cnt, uint8_t byte0, uint
     }
   }
 
-// Endpoint_Write_Stream_LE(&event, sizeof(event), NULL);
-// Endpoint_ClearIN();
-
+  // queued in the endpoint, usb_get_midi() flushes once per loop
   MIDI_Device_SendEventPacket(&USB_MIDI_Interface, &event);
-  MIDI_Device_Flush(&USB_MIDI_Interface);
-  MIDI_Device_USBTask(&USB_MIDI_Interface);
-  USB_USBTask();
+}
+
+static void usb_send_sysex_func(MidiDevice * device, uint16_t count, uint8_t * array) {
+  if (USB_DeviceState != DEVICE_STATE_Configured)
+    return;
+
+  // straight into the endpoint, a bank goes out each time it is full
+  Endpoint_SelectEndpoint(MIDI_STREAM_IN_EPADDR);
+  while (count) {
+    uint8_t n = (count > 3) ? 3 : count;
+    count -= n;
+    if (Endpoint_WaitUntilReady() != ENDPOINT_READYWAIT_NoError)
+      return;
+    Endpoint_Write_8(MIDI_EVENT(0, count ? SYSEX_START_OR_CONT : SYSEX_ENDS_IN_1 + ((n - 1) << 4)));
+    Endpoint_Write_8(array[0]);
+    Endpoint_Write_8((n > 1) ? array[1] : 0);
+    Endpoint_Write_8((n > 2) ? array[2] : 0);
+    array += n;
+    if (!Endpoint_IsReadWriteAllowed())
+      Endpoint_ClearIN();
+  }
 }
 
 static void usb_get_midi(MidiDevice * device) {
-  MIDI_EventPacket_t event;
-  while (MIDI_Device_ReceiveEventPacket(&USB_MIDI_Interface, &event)) {
-
-    midi_packet_length_t length = midi_packet_length(event.Data1);
-    uint8_t input[3];
-    input[0] = event.Data1;
-    input[1] = event.Data2;
-    input[2] = event.Data3;
-    if (length == UNDEFINED) {
-      //sysex
-      if (event.Event == MIDI_EVENT(0, SYSEX_START_OR_CONT) || event.Event == MIDI_EVENT(0, SYSEX_ENDS_IN_3)) {
-        length = 3;
-      } else if (event.Event == MIDI_EVENT(0, SYSEX_ENDS_IN_2)) {
-        length = 2;
-      } else if(event.Event ==  MIDI_EVENT(0, SYSEX_ENDS_IN_1)) {
-        length = 1;
-      } else {
-        //XXX what to do?
-      }
-    }
+  uint8_t packets[MIDI_STREAM_EPSIZE];
+
+  if (USB_DeviceState != DEVICE_STATE_Configured)
+    return;
+
+  // take the whole bank at once and give it back before the callbacks run,
+  // so the host can send the next one meanwhile
+  Endpoint_SelectEndpoint(MIDI_STREAM_OUT_EPADDR);
+  while (Endpoint_IsOUTReceived()) {
+    uint8_t length = Endpoint_BytesInEndpoint() & ~3;
+    Endpoint_Read_Stream_LE(packets, length, NULL);
+    Endpoint_ClearOUT();
 
-    //pass the data to the device input function
-    if (length != UNDEFINED)
-      midi_device_input(device, length, input);
+    midi_device_input_packets(device, length / 4, packets);
+    Endpoint_SelectEndpoint(MIDI_STREAM_OUT_EPADDR);
   }
   MIDI_Device_USBTask(&USB_MIDI_Interface);
   USB_USBTask();
@@ -956,6 +1136,7 @@ static void usb_get_midi(MidiDevice * device) {
 static void midi_usb_init(MidiDevice * device){
   midi_device_init(device);
   midi_device_set_send_func(device, usb_send_func);
+  midi_device_set_send_sysex_func(device, usb_send_sysex_func);
   midi_device_set_pre_input_process_func(device, usb_get_midi);
 
   // SetupHardware();
@@ -1110,7 +1291,7 @@ static void setup_usb(void)
 
     USB_Init();
 
-    // for Console_Task
+    // for the report queues and Console_Task
     USB_Device_EnableSOFEvents();
     print_set_sendchar(sendchar);
 }
@@ -1132,6 +1313,7 @@ int main(void)
 #ifdef MIDI_ENABLE
     midi_device_init(&midi_device);
     midi_device_set_send_func(&midi_device, usb_send_func);
+    midi_device_set_send_sysex_func(&midi_device, usb_send_sysex_func);
     midi_device_set_pre_input_process_func(&midi_device, usb_get_midi);
 #endif
 
@@ -1193,7 +1375,15 @@ int main(void)
         }
         #endif
 
+#ifdef SOF_SYNC_ENABLE
+        // scan just before the next frame, the rest of the loop keeps running
+        if (sof_sync_due()) {
+            keyboard_task();
+            sof_sync_done();
+        }
+#else
         keyboard_task();
+#endif
 
 #ifdef MIDI_ENABLE
         midi_device_process(&midi_device);
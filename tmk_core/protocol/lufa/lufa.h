@@ -67,6 +67,24 @@ typedef struct {
     uint16_t usage;
 } __attribute__ ((packed)) report_extra_t;
 
+/* reports each endpoint can hold while the host hasn't taken the last one */
+#ifndef REPORT_QUEUE_SIZE
+#define REPORT_QUEUE_SIZE 4
+#endif
+
+// Longest wait (ms) for room in a full report queue
+#ifndef REPORT_QUEUE_TIMEOUT
+#define REPORT_QUEUE_TIMEOUT 10
+#endif
+
+typedef struct {
+    uint16_t queued;
+    uint16_t merged;    // folded into a report already queued or sent
+    uint16_t dropped;   // overwritten in a full queue the host didn't drain
+} lufa_report_stats_t;
+
+extern lufa_report_stats_t lufa_report_stats;
+
 #ifdef MIDI_ENABLE
   void MIDI_Task(void);
   MidiDevice midi_device;
@@ -1,63 +1,51 @@
 #pragma once
-// A simple ringbuffer holding Size elements of type T
+#include "spsc_ring.h"
+// A simple ringbuffer holding Size elements of type T, for one producer and
+// one consumer; see spsc_ring.h
 template <typename T, uint8_t Size>
 class RingBuffer {
+  static_assert(SPSC_RING_SIZE_VALID(Size),
+                "RingBuffer size must be a power of two no larger than 128");
  protected:
   T buf_[Size];
-  uint8_t head_{0}, tail_{0};
+  spsc_ring_t ring_{0, 0};
  public:
-  inline uint8_t nextPosition(uint8_t position) {
-    return (position + 1) % Size;
-  }
-
-  inline uint8_t prevPosition(uint8_t position) {
-    if (position == 0) {
-      return Size - 1;
-    }
-    return position - 1;
-  }
-
   inline bool enqueue(const T &item) {
-    static_assert(Size > 1, "RingBuffer size must be > 1");
-    uint8_t next = nextPosition(head_);
-    if (next == tail_) {
+    if (!spsc_ring_space(&ring_, Size)) {
       // Full
       return false;
     }
 
-    buf_[head_] = item;
-    head_ = next;
+    buf_[spsc_ring_in(&ring_, Size, 0)] = item;
+    spsc_ring_commit(&ring_, 1);
     return true;
   }
 
   inline bool get(T &dest, bool commit = true) {
-    auto tail = tail_;
-    if (tail == head_) {
+    if (spsc_ring_empty(&ring_)) {
       // No more data
       return false;
     }
 
-    dest = buf_[tail];
-    tail = nextPosition(tail);
+    dest = buf_[spsc_ring_out(&ring_, Size, 0)];
 
     if (commit) {
-      tail_ = tail;
+      spsc_ring_release(&ring_, 1);
     }
     return true;
   }
 
-  inline bool empty() const { return head_ == tail_; }
+  inline bool empty() const { return spsc_ring_empty(&ring_); }
 
-  inline uint8_t size() const {
-    int diff = head_ - tail_;
-    if (diff >= 0) {
-      return diff;
-    }
-    return Size + diff;
-  }
+  inline uint8_t size() const { return spsc_ring_count(&ring_); }
 
   inline T& front() {
-    return buf_[tail_];
+    return buf_[spsc_ring_out(&ring_, Size, 0)];
+  }
+
+  // The item enqueued last; only valid if not empty()
+  inline T& back() {
+    return buf_[spsc_ring_in(&ring_, Size, Size - 1)];
   }
 
   inline bool peek(T &item) {
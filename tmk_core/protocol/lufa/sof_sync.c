@@ -0,0 +1,110 @@
+#include <avr/io.h>
+#include <util/atomic.h>
+#include "timer.h"
+#include "sof_sync.h"
+
+/* Time is kept in Timer0 ticks, (TIMER_RAW_TOP + 1) of them per ms */
+#define TICKS_PER_MS    (TIMER_RAW_TOP + 1)
+#define US_TO_TICKS(us) ((uint32_t)(us) * TICKS_PER_MS / 1000)
+#define TICKS_TO_US(t)  ((int32_t)(t) * 1000 / TICKS_PER_MS)
+
+extern volatile uint32_t timer_count;
+
+uint16_t sof_sync_lead = SOF_SYNC_LEAD;
+sof_sync_stats_t sof_sync_stats = { 0, INT16_MAX, INT16_MIN, 0 };
+
+static volatile uint16_t last_sof;
+static volatile uint8_t  frame = 0;     // counts start of frames
+static volatile bool     synced = false;
+static uint16_t frame_ticks = TICKS_PER_MS << 4;    // measured frame length, 12.4 fixed point
+
+static uint8_t  scanned = 0xFF;         // frame the last scan was for
+static volatile bool scan_pending = false;
+static volatile uint16_t scan_end;
+
+static uint16_t ticks(void)
+{
+    uint16_t ms;
+    uint8_t raw;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ms = timer_count;
+        raw = TIMER_RAW;
+        // Timer0 wrapped but its interrupt hasn't run yet
+        if ((TIFR0 & (1<<OCF0A)) && raw < TICKS_PER_MS / 2) ms++;
+    }
+    return ms * TICKS_PER_MS + raw;
+}
+
+static void phase_update(int16_t phase)
+{
+    sof_sync_stats.phase = phase;
+    if (phase < sof_sync_stats.phase_min) sof_sync_stats.phase_min = phase;
+    if (phase > sof_sync_stats.phase_max) sof_sync_stats.phase_max = phase;
+}
+
+void sof_sync_frame(void)
+{
+    uint16_t now = ticks();
+    uint16_t period = now - last_sof;
+
+    // follow the host's clock, ignoring frames we didn't see
+    if (synced && period > TICKS_PER_MS / 2 && period < TICKS_PER_MS * 2) {
+        frame_ticks += (int16_t)(period - (frame_ticks >> 4)) >> 2;
+    }
+    last_sof = now;
+    frame++;
+    synced = true;
+
+    if (scan_pending) {
+        scan_pending = false;
+        phase_update(TICKS_TO_US((uint16_t)(now - scan_end)));
+    }
+}
+
+bool sof_sync_due(void)
+{
+    uint16_t now = ticks();
+    uint16_t since, period;
+    uint8_t f;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        since = now - last_sof;
+        f = frame;
+        period = frame_ticks >> 4;
+    }
+
+    // no start of frame lately, run free
+    if (!synced || since > period * 2) {
+        synced = false;
+        scanned = f;
+        return true;
+    }
+    if (scanned == f) return false;
+    if (since + US_TO_TICKS(sof_sync_lead) < period) return false;
+
+    scanned = f;
+    return true;
+}
+
+void sof_sync_done(void)
+{
+    if (!synced) return;
+
+    uint16_t now = ticks();
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (frame != scanned) {
+            // the frame began while scanning, the lead is too short
+            sof_sync_stats.late++;
+            phase_update(-TICKS_TO_US((uint16_t)(now - last_sof)));
+        } else {
+            scan_end = now;
+            scan_pending = true;
+        }
+    }
+}
+
+void sof_sync_stats_clear(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        sof_sync_stats = (sof_sync_stats_t){ 0, INT16_MAX, INT16_MIN, 0 };
+    }
+}
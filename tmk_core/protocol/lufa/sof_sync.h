@@ -0,0 +1,43 @@
+#ifndef SOF_SYNC_H
+#define SOF_SYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Start of frame synchronized scanning
+ *
+ * Instead of scanning as fast as it can, the main loop scans once per USB
+ * frame, sof_sync_lead us before the next start of frame is due. The
+ * reports of that scan are queued right before the frame starts and are
+ * flushed at SOF, so the host reads the freshest state there is.
+ *
+ * The frame length is measured against Timer0, so it stays right even when
+ * the crystal is a bit off. Without start of frame (USB not configured,
+ * suspended, Bluetooth only) the loop runs free as before.
+ */
+
+/* us before start of frame to begin a scan; has to cover one keyboard_task() */
+#ifndef SOF_SYNC_LEAD
+#define SOF_SYNC_LEAD 250
+#endif
+
+typedef struct {
+    int16_t  phase;     // us from the end of the last scan to SOF, negative if late
+    int16_t  phase_min;
+    int16_t  phase_max;
+    uint16_t late;      // scans still running when their frame started
+} sof_sync_stats_t;
+
+extern uint16_t sof_sync_lead;
+extern sof_sync_stats_t sof_sync_stats;
+
+/* From EVENT_USB_Device_StartOfFrame() */
+void sof_sync_frame(void);
+
+/* True when it is time for the next scan, then sof_sync_done() after it */
+bool sof_sync_due(void);
+void sof_sync_done(void);
+
+void sof_sync_stats_clear(void);
+
+#endif
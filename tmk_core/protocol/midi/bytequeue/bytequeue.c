@@ -18,48 +18,29 @@
 //along with avr-bytequeue.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "bytequeue.h"
-#include "interrupt_setting.h"
 
 void bytequeue_init(byteQueue_t * queue, uint8_t * dataArray, byteQueueIndex_t arrayLen){
-   queue->length = arrayLen;
+   //a length the ring can't index leaves the queue without room, so every
+   //enqueue fails instead of writing past the array
+   queue->length = SPSC_RING_SIZE_VALID(arrayLen) ? arrayLen : 0;
    queue->data = dataArray;
-   queue->start = queue->end = 0;
+   spsc_ring_init(&queue->ring);
 }
 
 bool bytequeue_enqueue(byteQueue_t * queue, uint8_t item){
-   interrupt_setting_t setting = store_and_clear_interrupt();
-   //full
-   if(((queue->end + 1) % queue->length) == queue->start){
-      restore_interrupt_setting(setting);
-      return false;
-   } else {
-      queue->data[queue->end] = item;
-      queue->end = (queue->end + 1) % queue->length;
-      restore_interrupt_setting(setting);
-      return true;
-   }
+   return spsc_ring_put(&queue->ring, queue->data, queue->length, item);
 }
 
 byteQueueIndex_t bytequeue_length(byteQueue_t * queue){
-   byteQueueIndex_t len;
-   interrupt_setting_t setting = store_and_clear_interrupt();
-   if(queue->end >= queue->start)
-      len = queue->end - queue->start;
-   else
-      len = (queue->length - queue->start) + queue->end;
-   restore_interrupt_setting(setting);
-   return len;
+   return spsc_ring_count(&queue->ring);
 }
 
 //we don't need to avoid interrupts if there is only one reader
 uint8_t bytequeue_get(byteQueue_t * queue, byteQueueIndex_t index){
-   return queue->data[(queue->start + index) % queue->length];
+   return spsc_ring_peek(&queue->ring, queue->data, queue->length, index);
 }
 
 //we just update the start index to remove elements
 void bytequeue_remove(byteQueue_t * queue, byteQueueIndex_t numToRemove){
-   interrupt_setting_t setting = store_and_clear_interrupt();
-   queue->start = (queue->start + numToRemove) % queue->length;
-   restore_interrupt_setting(setting);
+   spsc_ring_release(&queue->ring, numToRemove);
 }
-
@@ -26,17 +26,20 @@ extern "C" {
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include "spsc_ring.h"
 
 typedef uint8_t byteQueueIndex_t;
 
 typedef struct {
-	byteQueueIndex_t start;
-	byteQueueIndex_t end;
+	spsc_ring_t ring;
 	byteQueueIndex_t length;
 	uint8_t * data;
 } byteQueue_t;
 
 //you must have a queue, an array of data which the queue will use, and the length of that array
+//the length has to be a power of two no larger than 128, all of it is used,
+//with any other length the queue holds nothing
+//one writer and one reader may use the queue without turning interrupts off
 void bytequeue_init(byteQueue_t * queue, uint8_t * dataArray, byteQueueIndex_t arrayLen);
 
 //add an item to the queue, returns false if the queue is full
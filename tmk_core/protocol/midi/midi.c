@@ -204,6 +204,13 @@ void midi_send_data(MidiDevice * device, uint16_t count, uint8_t byte0, uint8_t
 }
 
 void midi_send_array(MidiDevice * device, uint16_t count, uint8_t * array) {
+  //a device that can take the whole sysex at once
+  if (device->send_sysex_func && count &&
+      array[0] == SYSEX_BEGIN && array[count - 1] == SYSEX_END) {
+    device->send_sysex_func(device, count, array);
+    return;
+  }
+
   uint16_t i;
   for (i = 0; i < count; i += 3) {
     uint8_t b[3] = { 0, 0, 0 };
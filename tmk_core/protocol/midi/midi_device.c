@@ -28,6 +28,7 @@ void midi_input_callbacks(MidiDevice * device, uint16_t cnt, uint8_t byte0, uint
 void midi_process_byte(MidiDevice * device, uint8_t input);
 
 void midi_device_init(MidiDevice * device){
+  device->send_sysex_func = NULL;
   device->input_state = IDLE;
   device->input_count = 0;
   bytequeue_init(&device->input_queue, device->input_queue_data, MIDI_INPUT_QUEUE_LENGTH);
@@ -68,6 +69,10 @@ void midi_device_set_send_func(MidiDevice * device, midi_var_byte_func_t send_fu
   device->send_func = send_func;
 }
 
+void midi_device_set_send_sysex_func(MidiDevice * device, midi_array_func_t send_sysex_func){
+  device->send_sysex_func = send_sysex_func;
+}
+
 void midi_device_set_pre_input_process_func(MidiDevice * device, midi_no_byte_func_t pre_process_func){
   device->pre_input_process_callback = pre_process_func;
 }
@@ -77,14 +82,74 @@ void midi_device_process(MidiDevice * device) {
   if(device->pre_input_process_callback)
     device->pre_input_process_callback(device);
 
-  //pull stuff off the queue and process
+  //pull stuff off the queue and process, then release it all at once
   byteQueueIndex_t len = bytequeue_length(&device->input_queue);
   uint16_t i;
   //TODO limit number of bytes processed?
   for(i = 0; i < len; i++) {
-    uint8_t val = bytequeue_get(&device->input_queue, 0);
+    uint8_t val = bytequeue_get(&device->input_queue, i);
     midi_process_byte(device, val);
-    bytequeue_remove(&device->input_queue, 1);
+  }
+  bytequeue_remove(&device->input_queue, len);
+}
+
+//USB-MIDI Code Index Numbers: data bytes in the packet, and the sysex ones
+#define CIN_LENGTH 0x03
+#define CIN_SYSEX 0x04
+#define CIN_SYSEX_END 0x08
+
+static const uint8_t cin_table[16] = {
+  0,                              //0x0 misc, reserved
+  0,                              //0x1 cable events, reserved
+  2,                              //0x2 two byte system common
+  3,                              //0x3 three byte system common
+  3 | CIN_SYSEX,                  //0x4 sysex starts or continues
+  1,                              //0x5 one byte system common, or sysex ends with 1
+  2 | CIN_SYSEX | CIN_SYSEX_END,  //0x6 sysex ends with 2
+  3 | CIN_SYSEX | CIN_SYSEX_END,  //0x7 sysex ends with 3
+  3,                              //0x8 note off
+  3,                              //0x9 note on
+  3,                              //0xA poly key pressure
+  3,                              //0xB control change
+  2,                              //0xC program change
+  2,                              //0xD channel pressure
+  3,                              //0xE pitch bend
+  1,                              //0xF single byte
+};
+
+void midi_device_input_packets(MidiDevice * device, uint8_t count, uint8_t * packets) {
+  for (; count; count--, packets += 4) {
+    uint8_t type = cin_table[packets[0] & 0x0F];
+    uint8_t length = type & CIN_LENGTH;
+    uint8_t * data = packets + 1;
+
+    if (!length)
+      continue;
+    if ((packets[0] & 0x0F) == 0x05 && data[0] == SYSEX_END)
+      type |= CIN_SYSEX | CIN_SYSEX_END;
+
+    if (type & CIN_SYSEX) {
+      //the packet is the chunk, no need to collect bytes
+      const uint16_t start = device->input_count;
+      device->input_state = SYSEX_MESSAGE;
+      device->input_count += length;
+      if (device->input_sysex_callback)
+        device->input_sysex_callback(device, start, length, data);
+      else if (device->input_fallthrough_callback)
+        device->input_fallthrough_callback(device, device->input_count, data[0], data[1], data[2]);
+      if (device->input_catchall_callback)
+        device->input_catchall_callback(device, device->input_count, data[0], data[1], data[2]);
+      if (type & CIN_SYSEX_END) {
+        device->input_state = IDLE;
+        device->input_count = 0;
+      }
+    } else {
+      //may come in the middle of a sysex, like realtime bytes
+      input_state_t state = device->input_state;
+      device->input_state = (input_state_t)length;
+      midi_input_callbacks(device, length, data[0], data[1], data[2]);
+      device->input_state = state;
+    }
   }
 }
 
@@ -49,7 +49,7 @@ extern "C" {
 
 #include "midi_function_types.h"
 #include "bytequeue/bytequeue.h"
-#define MIDI_INPUT_QUEUE_LENGTH 192
+#define MIDI_INPUT_QUEUE_LENGTH 128
 
 typedef enum {
    IDLE, 
@@ -73,6 +73,8 @@ typedef void (* midi_no_byte_func_t)(MidiDevice * device);
 struct _midi_device {
    //output send function
    midi_var_byte_func_t send_func;
+   //optional, sends a whole sysex at once
+   midi_array_func_t send_sysex_func;
 
    //********input callbacks
    //three byte funcs
@@ -124,6 +126,20 @@ struct _midi_device {
  */
 void midi_device_input(MidiDevice * device, uint8_t cnt, uint8_t * input);
 
+/**
+ * @brief Process USB-MIDI event packets.  Like midi_device_input but for
+ * devices that get their input as 4 byte USB-MIDI event packets.  The Code
+ * Index Number of each packet tells how many bytes it has and whether it is
+ * part of a sysex, so the packets are dispatched to the callbacks right away
+ * instead of going through the input queue byte by byte.  A sysex packet
+ * calls the sysex callback once, with data pointing into the packet.
+ *
+ * @param device the midi device to associate the input with
+ * @param count the number of packets
+ * @param packets count * 4 bytes of packets
+ */
+void midi_device_input_packets(MidiDevice * device, uint8_t count, uint8_t * packets);
+
 /**
  * @brief Set the callback function that will be used for sending output
  * data bytes.  This is only used if you're creating a custom device.
@@ -136,6 +152,16 @@ void midi_device_input(MidiDevice * device, uint8_t cnt, uint8_t * input);
  */
 void midi_device_set_send_func(MidiDevice * device, midi_var_byte_func_t send_func);
 
+/**
+ * @brief Set the callback function that will be used by midi_send_array
+ * to send a complete sysex message in one go, instead of passing it to the
+ * send function 3 bytes at a time.  Optional.
+ *
+ * \param device the midi device to associate this callback with
+ * \param send_sysex_func the callback function that will do the sending
+ */
+void midi_device_set_send_sysex_func(MidiDevice * device, midi_array_func_t send_sysex_func);
+
 /**
  * @brief Set a callback which is called at the beginning of the
  * midi_device_process call.  This can be used to poll for input
@@ -43,6 +43,9 @@ typedef void (* midi_var_byte_func_t)(MidiDevice * device, uint16_t count, uint8
 //the start byte tells you how far into the sysex message you are, the data_length tells you how many bytes data is
 typedef void (* midi_sysex_func_t)(MidiDevice * device, uint16_t start_byte, uint8_t data_length, uint8_t *data);
 
+//a whole message of count bytes, for instance a sysex from SYSEX_BEGIN to SYSEX_END
+typedef void (* midi_array_func_t)(MidiDevice * device, uint16_t count, uint8_t * array);
+
 #ifdef __cplusplus
 }
 #endif 
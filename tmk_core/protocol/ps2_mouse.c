@@ -19,7 +19,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include<avr/io.h>
 #include<util/delay.h>
 #include "ps2_mouse.h"
-#include "host.h"
+#include "pointer.h"
 #include "timer.h"
 #include "print.h"
 #include "report.h"
@@ -34,7 +34,6 @@ static inline void ps2_mouse_print_report(report_mouse_t *mouse_report);
 static inline void ps2_mouse_convert_report_to_hid(report_mouse_t *mouse_report);
 static inline void ps2_mouse_clear_report(report_mouse_t *mouse_report);
 static inline void ps2_mouse_enable_scrolling(void);
-static inline void ps2_mouse_scroll_button_task(report_mouse_t *mouse_report);
 
 /* ============================= IMPLEMENTATION ============================ */
 
@@ -63,6 +62,11 @@ void ps2_mouse_init(void) {
     ps2_mouse_set_scaling_2_1();
 #endif
 
+#if PS2_MOUSE_SCROLL_BTN_MASK
+    pointer_set_scroll(POINTER_PS2, PS2_MOUSE_SCROLL_BTN_MASK, PS2_MOUSE_SCROLL_BTN_SEND,
+                       PS2_MOUSE_SCROLL_DIVISOR_V, PS2_MOUSE_SCROLL_DIVISOR_H);
+#endif
+
     ps2_mouse_init_user();
 }
 
@@ -97,14 +101,11 @@ void ps2_mouse_task(void) {
 #endif
         buttons_prev = mouse_report.buttons;
         ps2_mouse_convert_report_to_hid(&mouse_report);
-#if PS2_MOUSE_SCROLL_BTN_MASK
-        ps2_mouse_scroll_button_task(&mouse_report);
-#endif
 #ifdef PS2_MOUSE_DEBUG_HID
-        // Used to debug the bytes sent to the host
+        // Used to debug the bytes handed to the pointer stage, which does the scroll button
         ps2_mouse_print_report(&mouse_report);
 #endif
-        host_mouse_send(&mouse_report);
+        pointer_add(POINTER_PS2, &mouse_report);
     }
     
     ps2_mouse_clear_report(&mouse_report);
@@ -200,47 +201,3 @@ static inline void ps2_mouse_enable_scrolling(void) {
     PS2_MOUSE_SEND(PS2_MOUSE_GET_DEVICE_ID, "Finished enabling scroll wheel");
     _delay_ms(20);
 }
-
-#define PRESS_SCROLL_BUTTONS    mouse_report->buttons |= (PS2_MOUSE_SCROLL_BTN_MASK)
-#define RELEASE_SCROLL_BUTTONS  mouse_report->buttons &= ~(PS2_MOUSE_SCROLL_BTN_MASK)
-static inline void ps2_mouse_scroll_button_task(report_mouse_t *mouse_report) {
-    static enum { 
-        SCROLL_NONE, 
-        SCROLL_BTN, 
-        SCROLL_SENT,
-    } scroll_state = SCROLL_NONE;
-    static uint16_t scroll_button_time = 0;
-
-    if (PS2_MOUSE_SCROLL_BTN_MASK == (mouse_report->buttons & (PS2_MOUSE_SCROLL_BTN_MASK))) {
-        // All scroll buttons are pressed
-
-        if (scroll_state == SCROLL_NONE) {
-            scroll_button_time = timer_read();
-            scroll_state = SCROLL_BTN;
-        }
-
-        // If the mouse has moved, update the report to scroll instead of move the mouse
-        if (mouse_report->x || mouse_report->y) {
-            scroll_state = SCROLL_SENT;
-            mouse_report->v = -mouse_report->y/(PS2_MOUSE_SCROLL_DIVISOR_V);
-            mouse_report->h =  mouse_report->x/(PS2_MOUSE_SCROLL_DIVISOR_H);
-            mouse_report->x = 0;
-            mouse_report->y = 0;
-        }
-    } else if (0 == (PS2_MOUSE_SCROLL_BTN_MASK & mouse_report->buttons)) {
-        // None of the scroll buttons are pressed 
-
-#if PS2_MOUSE_SCROLL_BTN_SEND
-        if (scroll_state == SCROLL_BTN 
-                && timer_elapsed(scroll_button_time) < PS2_MOUSE_SCROLL_BTN_SEND) {
-            PRESS_SCROLL_BUTTONS;
-            host_mouse_send(mouse_report);
-            _delay_ms(100);
-            RELEASE_SCROLL_BUTTONS;
-        }
-#endif
-        scroll_state = SCROLL_NONE;
-    }
-
-    RELEASE_SCROLL_BUTTONS;
-}
@@ -0,0 +1,74 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "scan_decoder.h"
+
+
+const scan_transition_t scan_set2[SCAN_SET2_SIZE] PROGMEM = {
+    { 0x00,                             0xF0, SCAN_BREAK },
+    { 0x00,                             0xE0, SCAN_PAGE_E0 },
+    { SCAN_PAGE_E0,                     0xF0, SCAN_PAGE_E0 | SCAN_BREAK },
+    // Pause: E1 14 77 E1 F0 14 F0 77
+    { 0x00,                             0xE1, SCAN_PAGE_E1 },
+    { SCAN_PAGE_E1,                     0x14, SCAN_PAGE_E1 | SCAN_STEP(1) },
+    { SCAN_PAGE_E1,                     0xF0, SCAN_PAGE_E1 | SCAN_BREAK },
+    { SCAN_PAGE_E1 | SCAN_BREAK,        0x14, SCAN_PAGE_E1 | SCAN_BREAK | SCAN_STEP(1) },
+    { SCAN_PAGE_E1 | SCAN_BREAK | SCAN_STEP(1), 0xF0, SCAN_PAGE_E1 | SCAN_BREAK | SCAN_STEP(2) },
+};
+
+const scan_transition_t scan_set3[SCAN_SET3_SIZE] PROGMEM = {
+    { 0x00,                             0xF0, SCAN_BREAK },
+};
+
+
+void scan_decoder_init(scan_decoder_t *d, const scan_transition_t *table, uint8_t size)
+{
+    d->table = table;
+    d->size = size;
+    d->state = 0;
+    d->held = false;
+}
+
+bool scan_decoder_feed(scan_decoder_t *d, uint8_t code, scan_event_t *event)
+{
+    for (uint8_t i = 0; i < d->size; i++) {
+        const scan_transition_t *t = &d->table[i];
+        if (pgm_read_byte(&t->from) == d->state && pgm_read_byte(&t->code) == code) {
+            d->state = pgm_read_byte(&t->to);
+            return false;
+        }
+    }
+    event->state = d->state & (SCAN_BREAK | 0x0F);
+    event->code = code;
+    d->state = 0;
+    return true;
+}
+
+void scan_decoder_task(scan_decoder_t *d, uint8_t (*recv)(void), void (*event)(scan_event_t))
+{
+    scan_event_t done[SCAN_DECODER_EVENTS];
+    uint8_t count = 0;
+
+    if (d->held) {
+        d->held = false;
+        event(d->event);
+        done[count++] = d->event;
+    }
+
+    uint8_t code;
+    while ((code = recv())) {
+        scan_event_t e;
+        if (!scan_decoder_feed(d, code, &e)) continue;
+
+        bool again = (count == SCAN_DECODER_EVENTS);
+        for (uint8_t i = 0; i < count && !again; i++) {
+            again = (SCAN_PAGE(done[i].state) == SCAN_PAGE(e.state) && done[i].code == e.code);
+        }
+        if (again) {
+            d->event = e;
+            d->held = true;
+            return;
+        }
+        event(e);
+        done[count++] = e;
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef SCAN_DECODER_H
+#define SCAN_DECODER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "progmem.h"
+
+/* Table driven scan code decoder
+ *
+ * Prefix bytes like E0, F0 and E1 are not decoded by hand-written states.
+ * They are transitions in a table the converter passes in, so the same
+ * decoder reads any code set.
+ *
+ * A state is one byte. The low nibble is the page the key code lands in:
+ * 0 for plain codes, and SCAN_PAGE_E0 and SCAN_PAGE_E1 in the tables
+ * below. Bits 4-6 tell apart the steps of a longer prefix, and SCAN_BREAK
+ * marks a break. A byte with no transition from the current state is the
+ * key code itself. It comes out with the page and break bit of that state,
+ * and the decoder goes back to state 0.
+ */
+
+#define SCAN_BREAK      0x80
+#define SCAN_PAGE(s)    ((s) & 0x0F)
+#define SCAN_STEP(n)    ((n) << 4)
+
+#define SCAN_PAGE_E0    1
+#define SCAN_PAGE_E1    2
+
+typedef struct {
+    uint8_t from;
+    uint8_t code;
+    uint8_t to;
+} scan_transition_t;
+
+typedef struct {
+    uint8_t state;      // page and SCAN_BREAK
+    uint8_t code;
+} scan_event_t;
+
+/* Most key events handled by one scan_decoder_task() */
+#ifndef SCAN_DECODER_EVENTS
+#define SCAN_DECODER_EVENTS 8
+#endif
+
+typedef struct {
+    const scan_transition_t *table;     // in PROGMEM
+    uint8_t size;
+    uint8_t state;
+    bool held;                          // event is held for the next task
+    scan_event_t event;
+} scan_decoder_t;
+
+/* Code set 2 with the E0 and E1 prefixes, and code set 3 */
+extern const scan_transition_t scan_set2[] PROGMEM;
+extern const scan_transition_t scan_set3[] PROGMEM;
+#define SCAN_SET2_SIZE  8
+#define SCAN_SET3_SIZE  1
+
+void scan_decoder_init(scan_decoder_t *d, const scan_transition_t *table, uint8_t size);
+
+/* Decodes one byte, true when it completes a key event */
+bool scan_decoder_feed(scan_decoder_t *d, uint8_t code, scan_event_t *event);
+
+/* Decodes everything recv() has, 0 meaning nothing left, and calls
+ * event() for each key event in the order they arrived. An event for a key
+ * that already changed in this call is held back for the next one, so a
+ * press and release within one scan still reach the matrix as both. */
+void scan_decoder_task(scan_decoder_t *d, uint8_t (*recv)(void), void (*event)(scan_event_t));
+
+#endif
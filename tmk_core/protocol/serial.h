@@ -38,10 +38,16 @@ POSSIBILITY OF SUCH DAMAGE.
 #ifndef SERIAL_H
 #define SERIAL_H
 
+#include <stdint.h>
+#include <stdbool.h>
+#include "serial_tx.h"
+
 /* host role */
 void serial_init(void);
 uint8_t serial_recv(void);
 int16_t serial_recv2(void);
 void serial_send(uint8_t data);
+/* See serial_tx_put(); without a buffered transmitter it is sent right away */
+bool serial_send_frame(const uint8_t *data, uint8_t len, uint8_t kind, bool merge);
 
 #endif
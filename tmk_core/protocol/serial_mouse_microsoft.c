@@ -22,7 +22,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "serial.h"
 #include "serial_mouse.h"
 #include "report.h"
-#include "host.h"
+#include "pointer.h"
 #include "timer.h"
 #include "print.h"
 #include "debug.h"
@@ -70,7 +70,7 @@ void serial_mouse_task(void)
         report.x = report.y = 0;
 
         print_usb_data(&report);
-        host_mouse_send(&report);
+        pointer_add(POINTER_SERIAL, &report);
         return;
     }
 
@@ -110,7 +110,7 @@ void serial_mouse_task(void)
 #endif
 
     print_usb_data(&report);
-    host_mouse_send(&report);
+    pointer_add(POINTER_SERIAL, &report);
 }
 
 static void print_usb_data(const report_mouse_t *report)
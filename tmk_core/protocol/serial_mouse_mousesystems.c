@@ -22,7 +22,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "serial.h"
 #include "serial_mouse.h"
 #include "report.h"
-#include "host.h"
+#include "pointer.h"
 #include "timer.h"
 #include "print.h"
 #include "debug.h"
@@ -77,14 +77,14 @@ void serial_mouse_task(void)
         report.v = MAX((int8_t)buffer[2], -127);
 
         print_usb_data(&report);
-        host_mouse_send(&report);
+        pointer_add(POINTER_SERIAL, &report);
 
         if (buffer[3] || buffer[4]) {
             report.h = MAX((int8_t)buffer[3], -127);
             report.v = MAX((int8_t)buffer[4], -127);
 
             print_usb_data(&report);
-            host_mouse_send(&report);
+            pointer_add(POINTER_SERIAL, &report);
         }
 
         return;
@@ -109,14 +109,14 @@ void serial_mouse_task(void)
     report.y = MAX(-(int8_t)buffer[2], -127);
 
     print_usb_data(&report);
-    host_mouse_send(&report);
+    pointer_add(POINTER_SERIAL, &report);
 
     if (buffer[3] || buffer[4]) {
         report.x = MAX((int8_t)buffer[3], -127);
         report.y = MAX(-(int8_t)buffer[4], -127);
 
         print_usb_data(&report);
-        host_mouse_send(&report);
+        pointer_add(POINTER_SERIAL, &report);
     }
 }
 
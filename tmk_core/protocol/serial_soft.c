@@ -172,6 +172,12 @@ void serial_send(uint8_t data)
     _delay_us(WAIT_US);
 }
 
+bool serial_send_frame(const uint8_t *data, uint8_t len, uint8_t kind, bool merge)
+{
+    while (len--) serial_send(*data++);
+    return false;
+}
+
 /* detect edge of start bit */
 ISR(SERIAL_SOFT_RXD_VECT)
 {
@@ -0,0 +1,71 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <util/atomic.h>
+#include "serial_tx.h"
+
+#define MASK (SERIAL_TX_SIZE - 1)
+
+#if (SERIAL_TX_SIZE & MASK) || SERIAL_TX_SIZE > 128
+#error "SERIAL_TX_SIZE must be a power of two no larger than 128"
+#endif
+
+/* Free running positions, the queue holds the bytes from head to tail */
+static uint8_t buf[SERIAL_TX_SIZE];
+static volatile uint8_t head = 0;     // next to send, moved by the interrupt
+static volatile uint8_t tail = 0;     // next to fill, moved by the main loop
+
+/* The last frame queued of each kind */
+static struct {
+    uint8_t start;
+    uint8_t len;
+} last[SERIAL_TX_KINDS];
+
+static bool queued(uint8_t pos)
+{
+    return (uint8_t)(pos - head) < (uint8_t)(tail - head);
+}
+
+static void copy(uint8_t pos, const uint8_t *data, uint8_t len)
+{
+    while (len--) {
+        buf[pos++ & MASK] = *data++;
+    }
+}
+
+bool serial_tx_put(const uint8_t *data, uint8_t len, uint8_t kind, bool merge)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        // not one byte of it has gone out yet, so it can still be replaced
+        if (merge && kind && last[kind].len == len && queued(last[kind].start)) {
+            copy(last[kind].start, data, len);
+            return true;
+        }
+        // forget frames that went out, before their positions come around again
+        for (uint8_t i = 1; i < SERIAL_TX_KINDS; i++) {
+            if (!queued(last[i].start)) last[i].len = 0;
+        }
+    }
+
+    // the interrupt makes room
+    while (SERIAL_TX_SIZE - (uint8_t)(tail - head) < len) ;
+
+    uint8_t start = tail;
+    copy(start, data, len);
+    tail = start + len;
+    if (kind) {
+        last[kind].start = start;
+        last[kind].len = len;
+    }
+    return false;
+}
+
+int16_t serial_tx_get(void)
+{
+    if (head == tail) return -1;
+    return buf[head++ & MASK];
+}
+
+bool serial_tx_empty(void)
+{
+    return head == tail;
+}
@@ -0,0 +1,38 @@
+#ifndef SERIAL_TX_H
+#define SERIAL_TX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Transmit queue for serial links to Bluetooth modules
+ *
+ * Bytes are queued here and sent from an interrupt of the transmitter, so
+ * sending a report only costs a copy in the main loop. A report that is
+ * still waiting when the next one of its kind comes in can be overwritten
+ * in place, so only the latest state goes out. The caller decides whether
+ * that loses anything, see keyboard_report_mergeable().
+ */
+
+/* bytes, a power of two no larger than 128 */
+#ifndef SERIAL_TX_SIZE
+#define SERIAL_TX_SIZE 64
+#endif
+
+/* Kinds of frame; a stream frame is never overwritten */
+enum {
+    SERIAL_TX_STREAM,
+    SERIAL_TX_KEYBOARD,
+    SERIAL_TX_KINDS
+};
+
+/* With merge, overwrites the last frame of the same kind and returns true if
+ * none of it has gone out yet. Otherwise queues data, waiting only until
+ * there is room for all of it; len is at most SERIAL_TX_SIZE. */
+bool serial_tx_put(const uint8_t *data, uint8_t len, uint8_t kind, bool merge);
+
+/* Next byte to transmit, -1 when empty; from the transmitter's interrupt */
+int16_t serial_tx_get(void);
+
+bool serial_tx_empty(void);
+
+#endif
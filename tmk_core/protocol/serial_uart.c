@@ -94,12 +94,43 @@ int16_t serial_recv2(void)
     return data;
 }
 
+#ifdef SERIAL_UART_TXD_VECT
+/* Sent from the data register empty interrupt */
+void serial_send(uint8_t data)
+{
+    serial_send_frame(&data, 1, SERIAL_TX_STREAM, false);
+}
+
+bool serial_send_frame(const uint8_t *data, uint8_t len, uint8_t kind, bool merge)
+{
+    bool merged = serial_tx_put(data, len, kind, merge);
+    SERIAL_UART_TXD_INT_ON();
+    return merged;
+}
+
+ISR(SERIAL_UART_TXD_VECT)
+{
+    int16_t data = serial_tx_get();
+    if (data < 0) {
+        SERIAL_UART_TXD_INT_OFF();
+    } else {
+        SERIAL_UART_DATA = data;
+    }
+}
+#else
 void serial_send(uint8_t data)
 {
     while (!SERIAL_UART_TXD_READY) ;
     SERIAL_UART_DATA = data;
 }
 
+bool serial_send_frame(const uint8_t *data, uint8_t len, uint8_t kind, bool merge)
+{
+    while (len--) serial_send(*data++);
+    return false;
+}
+#endif
+
 // USART RX complete interrupt
 ISR(SERIAL_UART_RXD_VECT)
 {
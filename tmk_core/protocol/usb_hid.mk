@@ -38,6 +38,11 @@ ARDUINO_CORES_SRC = \
 #
 SRC += $(USB_HID_DIR)/parser.cpp
 
+ifdef USB_HID_PASSTHROUGH
+    OPT_DEFS += -DUSB_HID_PASSTHROUGH
+    SRC += $(USB_HID_DIR)/passthrough.c
+endif
+
 # replace arduino/CDC.cpp
 SRC += $(USB_HID_DIR)/override_Serial.cpp
 
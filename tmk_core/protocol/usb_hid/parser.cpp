@@ -28,6 +28,11 @@ void KBDReportParser::Parse(HID *hid, bool is_rpt_id, uint8_t len, uint8_t *buf)
         return;
     }
 
+#ifdef USB_HID_PASSTHROUGH
+    usb_hid_time_stamp = millis();
+    usb_hid_passthrough_report(report, usb_hid_time_stamp);
+#else
     ::memcpy(&usb_hid_keyboard_report, buf, sizeof(report_keyboard_t));
     usb_hid_time_stamp = millis();
+#endif
 }
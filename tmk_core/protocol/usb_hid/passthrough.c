@@ -0,0 +1,102 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include "usb_hid.h"
+#include "action.h"
+#include "action_util.h"
+#include "host.h"
+
+
+#ifdef NKRO_ENABLE
+#   error "USB_HID_PASSTHROUGH forwards boot reports and can't be used with NKRO_ENABLE"
+#endif
+
+static report_keyboard_t last_report;
+static bool passing = false;
+
+__attribute__ ((weak))
+bool usb_hid_passthrough(const report_keyboard_t *report)
+{
+    return false;
+}
+
+static bool has_key(const report_keyboard_t *report, uint8_t code)
+{
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        if (report->keys[i] == code) return true;
+    }
+    return false;
+}
+
+static bool report_has_anykey(const report_keyboard_t *report)
+{
+    if (report->mods) return true;
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        if (report->keys[i]) return true;
+    }
+    return false;
+}
+
+static void key_event(uint8_t code, bool pressed, uint16_t time)
+{
+    keyevent_t event;
+    event.key.row = code >> 3;
+    event.key.col = code & 7;
+    event.pressed = pressed;
+    event.time = time | 1;      /* time should not be 0 */
+    action_exec(event);
+}
+
+/* Every change from prev to next, releases first. Returns false if none. */
+static bool report_diff(const report_keyboard_t *prev, const report_keyboard_t *next, uint16_t time)
+{
+    bool changed_any = false;
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        if (prev->keys[i] && !has_key(next, prev->keys[i])) {
+            key_event(prev->keys[i], false, time);
+            changed_any = true;
+        }
+    }
+    uint8_t changed = prev->mods ^ next->mods;
+    for (uint8_t i = 0; i < 8; i++) {
+        if (changed & (1<<i)) {
+            key_event(0xE0 + i, next->mods & (1<<i), time);
+            changed_any = true;
+        }
+    }
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        if (next->keys[i] && !has_key(prev, next->keys[i])) {
+            key_event(next->keys[i], true, time);
+            changed_any = true;
+        }
+    }
+    return changed_any;
+}
+
+void usb_hid_passthrough_report(const report_keyboard_t *report, uint16_t time)
+{
+    static const report_keyboard_t empty = {};
+
+    // only once the actions have released everything they pressed
+    if (usb_hid_passthrough(report) && (passing || !report_has_anykey(&last_report))) {
+        passing = true;
+        host_keyboard_send((report_keyboard_t *)report);
+    } else {
+        if (passing) {
+            // the host holds what was passed through: press it into the
+            // actions without sending anything, so a key held across the
+            // switch is not released and pressed again
+            host_driver_t *driver = host_get_driver();
+            host_set_driver(NULL);
+            report_diff(&empty, &last_report, time);
+            host_set_driver(driver);
+            passing = false;
+            // nothing changed, but the host still has the raw report
+            if (!report_diff(&last_report, report, time)) {
+                host_keyboard_send(keyboard_report);
+            }
+        } else {
+            report_diff(&last_report, report, time);
+        }
+    }
+    last_report = *report;
+}
@@ -0,0 +1,128 @@
+#include "gtest/gtest.h"
+#include <string.h>
+#include <vector>
+
+extern "C" {
+#include "usb_hid.h"
+#include "action.h"
+#include "action_util.h"
+#include "host.h"
+}
+
+static bool pass;
+static std::vector<report_keyboard_t> sent;
+static report_keyboard_t engine;
+static host_driver_t *driver;
+static host_driver_t usb_driver;
+
+extern "C" {
+report_keyboard_t *keyboard_report = &engine;
+
+bool usb_hid_passthrough(const report_keyboard_t *report) { return pass; }
+
+host_driver_t *host_get_driver(void) { return driver; }
+void host_set_driver(host_driver_t *d) { driver = d; }
+void host_keyboard_send(report_keyboard_t *report) {
+    if (driver) sent.push_back(*report);
+}
+
+// every key does what it says: its code at row << 3 | col
+void action_exec(keyevent_t event) {
+    uint8_t code = event.key.row << 3 | event.key.col;
+    if (code >= 0xE0) {
+        uint8_t bit = 1 << (code - 0xE0);
+        engine.mods = event.pressed ? engine.mods | bit : engine.mods & ~bit;
+    } else {
+        for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+            if (event.pressed ? engine.keys[i] == 0 : engine.keys[i] == code) {
+                engine.keys[i] = event.pressed ? code : 0;
+                break;
+            }
+        }
+    }
+    host_keyboard_send(&engine);
+}
+}
+
+static report_keyboard_t report(uint8_t mods, uint8_t key0 = 0, uint8_t key1 = 0) {
+    report_keyboard_t r = {};
+    r.mods = mods;
+    r.keys[0] = key0;
+    r.keys[1] = key1;
+    return r;
+}
+
+static bool has_key(const report_keyboard_t &r, uint8_t code) {
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        if (r.keys[i] == code) return true;
+    }
+    return false;
+}
+
+class Passthrough : public testing::Test {
+public:
+    Passthrough() {
+        driver = &usb_driver;
+        // leave the previous test's state on a passed through empty report
+        pass = true;
+        input(report(0));
+        memset(&engine, 0, sizeof(engine));
+        sent.clear();
+    }
+    void input(report_keyboard_t r) {
+        usb_hid_passthrough_report(&r, 100);
+    }
+};
+
+TEST_F(Passthrough, forwards_reports_unchanged) {
+    input(report(0, KC_A));
+    ASSERT_EQ(sent.size(), 1u);
+    EXPECT_TRUE(has_key(sent[0], KC_A));
+    EXPECT_FALSE(has_key(engine, KC_A));
+}
+
+TEST_F(Passthrough, holds_a_key_across_the_switch) {
+    input(report(0, KC_A));
+    pass = false;
+    input(report(0, KC_A, KC_B));
+    ASSERT_EQ(sent.size(), 2u);
+    for (auto &r : sent) {
+        EXPECT_TRUE(has_key(r, KC_A));
+    }
+    EXPECT_TRUE(has_key(sent[1], KC_B));
+    EXPECT_TRUE(has_key(engine, KC_A));
+    input(report(0));
+    ASSERT_EQ(sent.size(), 4u);
+    EXPECT_FALSE(has_key(sent[3], KC_A));
+    EXPECT_FALSE(has_key(sent[3], KC_B));
+}
+
+TEST_F(Passthrough, resends_when_the_switch_changes_no_key) {
+    input(report(MOD_BIT(KC_LSFT), KC_A));
+    pass = false;
+    input(report(MOD_BIT(KC_LSFT), KC_A));
+    ASSERT_EQ(sent.size(), 2u);
+    EXPECT_TRUE(has_key(sent[1], KC_A));
+    EXPECT_EQ(sent[1].mods, MOD_BIT(KC_LSFT));
+}
+
+TEST_F(Passthrough, releases_a_key_let_go_at_the_switch) {
+    input(report(0, KC_A));
+    pass = false;
+    input(report(0));
+    ASSERT_EQ(sent.size(), 2u);
+    EXPECT_FALSE(has_key(sent[1], KC_A));
+}
+
+TEST_F(Passthrough, waits_for_the_actions_to_release_everything) {
+    pass = false;
+    input(report(0, KC_A));
+    pass = true;
+    input(report(0, KC_A, KC_B));
+    ASSERT_EQ(sent.size(), 2u);
+    EXPECT_TRUE(has_key(engine, KC_B));
+    input(report(0));
+    input(report(0, KC_B));
+    EXPECT_FALSE(has_key(engine, KC_B));
+    EXPECT_TRUE(has_key(sent.back(), KC_B));
+}
@@ -0,0 +1,7 @@
+usb_hid_passthrough_SRC := \
+	$(TMK_PATH)/protocol/usb_hid/tests/passthrough_tests.cpp \
+	$(TMK_PATH)/protocol/usb_hid/passthrough.c
+usb_hid_passthrough_INC := \
+	$(TMK_PATH)/protocol/usb_hid
+usb_hid_passthrough_DEFS := \
+	-DUSB_HID_PASSTHROUGH
@@ -0,0 +1,2 @@
+TEST_LIST +=\
+	usb_hid_passthrough
@@ -7,4 +7,29 @@
 extern report_keyboard_t usb_hid_keyboard_report;
 extern uint16_t usb_hid_time_stamp;
 
+#ifdef USB_HID_PASSTHROUGH
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * With USB_HID_PASSTHROUGH the parser handles each report as it arrives
+ * instead of leaving it in usb_hid_keyboard_report for the matrix. A report
+ * for which this returns true goes to the computer unchanged, others are
+ * turned into the key events of every change since the last one, all with
+ * the time the report arrived, at row code>>3 and column code&7.
+ *
+ * Return true only when the keymap would not change the report, e.g. while
+ * no layer is on and none of its keys has an action. Default is never.
+ */
+bool usb_hid_passthrough(const report_keyboard_t *report);
+
+/* Called by the parser with every report, see usb_hid_passthrough() */
+void usb_hid_passthrough_report(const report_keyboard_t *report, uint16_t time);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
+
 #endif
@@ -91,10 +91,12 @@ int main(void)
 
             // TODO: configuration process is incosistent. it sometime fails.
             // To prevent failing to configure NOT scan keyboard during configuration
-            if (usbConfiguration && usbInterruptIsReady()) {
+            // Reports wait in vusb.c, so scanning goes on while the host hasn't
+            // taken the last one.
+            if (usbConfiguration) {
                 keyboard_task();
             }
-            vusb_transfer_keyboard();
+            vusb_transfer();
         }
     }
 }
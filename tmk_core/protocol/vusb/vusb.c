@@ -16,6 +16,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <stdint.h>
+#include <string.h>
 #include "usbdrv.h"
 #include "usbconfig.h"
 #include "host.h"
@@ -23,18 +24,21 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "print.h"
 #include "debug.h"
 #include "host_driver.h"
+#include "timer.h"
 #include "vusb.h"
 
 
 static uint8_t vusb_keyboard_leds = 0;
 static uint8_t vusb_idle_rate = 0;
 
-/* Keyboard report send buffer */
-#define KBUF_SIZE 16
-static report_keyboard_t kbuf[KBUF_SIZE];
-static uint8_t kbuf_head = 0;
-static uint8_t kbuf_tail = 0;
-
+/* Report buffers
+ *
+ * A low speed device is polled every USB_CFG_INTR_POLL_INTERVAL ms, far
+ * slower than reports are made during a macro or a fast roll. Reports wait
+ * here until the host takes them. A pending report is folded into the next
+ * one when the host can't tell the difference, and a full buffer waits for
+ * the host instead of dropping anything.
+ */
 typedef struct {
         uint8_t modifier;
         uint8_t reserved;
@@ -43,22 +47,128 @@ typedef struct {
 
 static keyboard_report_t keyboard_report; // sent to PC
 
-/* transfer keyboard report from buffer */
-void vusb_transfer_keyboard(void)
+#define KBUF_SIZE 16
+static report_keyboard_t kbuf[KBUF_SIZE];
+static uint8_t kbuf_head = 0;
+static uint8_t kbuf_tail = 0;
+
+typedef struct {
+    uint8_t report_id;
+    report_mouse_t report;
+} __attribute__ ((packed)) vusb_mouse_report_t;
+
+typedef struct {
+    uint8_t  report_id;
+    uint16_t usage;
+} __attribute__ ((packed)) report_extra_t;
+
+/* Mouse motion adds up while the buttons stay the same */
+typedef struct {
+    uint8_t buttons;
+    int16_t x, y, v, h;
+} mouse_motion_t;
+
+#define MBUF_SIZE 4
+static mouse_motion_t mbuf[MBUF_SIZE];
+static uint8_t mbuf_head = 0;
+static uint8_t mbuf_count = 0;
+
+#define EBUF_SIZE 4
+static report_extra_t ebuf[EBUF_SIZE];
+static uint8_t ebuf_head = 0;
+static uint8_t ebuf_count = 0;
+
+/* Give up waiting for a full buffer after this many ms, the host is gone */
+#ifndef VUSB_WAIT_TIMEOUT
+#define VUSB_WAIT_TIMEOUT (USB_CFG_INTR_POLL_INTERVAL * 5)
+#endif
+
+/* Set when a wait timed out, cleared once the host takes a report again.
+ * Until then full buffers don't wait, so a host that stopped polling costs
+ * one timeout and not one on every report. */
+static bool host_stalled = false;
+
+/* transfer reports from the buffers, whatever the host is ready for */
+void vusb_transfer(void)
 {
-    if (usbInterruptIsReady()) {
-        if (kbuf_head != kbuf_tail) {
-            usbSetInterrupt((void *)&kbuf[kbuf_tail], sizeof(report_keyboard_t));
-            kbuf_tail = (kbuf_tail + 1) % KBUF_SIZE;
-            if (debug_keyboard) {
-                print("V-USB: kbuf["); pdec(kbuf_tail); print("->"); pdec(kbuf_head); print("](");
-                phex((kbuf_head < kbuf_tail) ? (KBUF_SIZE - kbuf_tail + kbuf_head) : (kbuf_head - kbuf_tail));
-                print(")\n");
+    if (usbInterruptIsReady() && kbuf_head != kbuf_tail) {
+        usbSetInterrupt((void *)&kbuf[kbuf_tail], sizeof(report_keyboard_t));
+        host_stalled = false;
+        memcpy(&keyboard_report, &kbuf[kbuf_tail], sizeof(keyboard_report));
+        kbuf_tail = (kbuf_tail + 1) % KBUF_SIZE;
+        if (debug_keyboard) {
+            print("V-USB: kbuf["); pdec(kbuf_tail); print("->"); pdec(kbuf_head); print("](");
+            phex((kbuf_head < kbuf_tail) ? (KBUF_SIZE - kbuf_tail + kbuf_head) : (kbuf_head - kbuf_tail));
+            print(")\n");
+        }
+    }
+
+    if (!usbInterruptIsReady3()) return;
+
+    // mouse and extra keys share endpoint 3
+    if (ebuf_count) {
+        usbSetInterrupt3((void *)&ebuf[ebuf_head], sizeof(report_extra_t));
+        host_stalled = false;
+        ebuf_head = (ebuf_head + 1) % EBUF_SIZE;
+        ebuf_count--;
+    } else if (mbuf_count) {
+        mouse_motion_t *m = &mbuf[mbuf_head];
+        vusb_mouse_report_t r = {
+            .report_id = REPORT_ID_MOUSE,
+            .report = {
+                .buttons = m->buttons,
+                .x = m->x > 127 ? 127 : (m->x < -127 ? -127 : m->x),
+                .y = m->y > 127 ? 127 : (m->y < -127 ? -127 : m->y),
+                .v = m->v > 127 ? 127 : (m->v < -127 ? -127 : m->v),
+                .h = m->h > 127 ? 127 : (m->h < -127 ? -127 : m->h),
             }
+        };
+        usbSetInterrupt3((void *)&r, sizeof(vusb_mouse_report_t));
+        host_stalled = false;
+        m->x -= r.report.x;
+        m->y -= r.report.y;
+        m->v -= r.report.v;
+        m->h -= r.report.h;
+        // what didn't fit goes with the next poll
+        if (!m->x && !m->y && !m->v && !m->h) {
+            mbuf_head = (mbuf_head + 1) % MBUF_SIZE;
+            mbuf_count--;
         }
     }
 }
 
+static bool kbuf_full(void) { return (kbuf_head + 1) % KBUF_SIZE == kbuf_tail; }
+static bool mbuf_full(void) { return mbuf_count == MBUF_SIZE; }
+static bool ebuf_full(void) { return ebuf_count == EBUF_SIZE; }
+
+/* Keeps USB going until the host takes a report from a full buffer.
+ * Returns false if it doesn't within VUSB_WAIT_TIMEOUT, and right away
+ * while the device isn't configured or the host stalled before. */
+static bool vusb_wait(bool (*full)(void))
+{
+    if (!full()) return true;
+    if (!usbConfiguration || host_stalled) return false;
+
+    uint16_t start = timer_read();
+    while (full()) {
+        if (timer_elapsed(start) > VUSB_WAIT_TIMEOUT) {
+            host_stalled = true;
+            return false;
+        }
+        usbPoll();
+        vusb_transfer();
+    }
+    return true;
+}
+
+/* int is 16 bits on AVR, so a + b must not overflow */
+static inline int16_t add_sat(int16_t a, int8_t b)
+{
+    if (b > 0 && a > INT16_MAX - b) return INT16_MAX;
+    if (b < 0 && a < INT16_MIN - b) return INT16_MIN;
+    return a + b;
+}
+
 
 /*------------------------------------------------------------------*
  * Host driver
@@ -88,41 +198,66 @@ static uint8_t keyboard_leds(void) {
 
 static void send_keyboard(report_keyboard_t *report)
 {
-    uint8_t next = (kbuf_head + 1) % KBUF_SIZE;
-    if (next != kbuf_tail) {
-        kbuf[kbuf_head] = *report;
-        kbuf_head = next;
-    } else {
+    if (kbuf_head != kbuf_tail) {
+        uint8_t last = (kbuf_head + KBUF_SIZE - 1) % KBUF_SIZE;
+        const report_keyboard_t *prev = (last == kbuf_tail) ?
+            (const report_keyboard_t *)&keyboard_report : &kbuf[(last + KBUF_SIZE - 1) % KBUF_SIZE];
+        if (keyboard_report_mergeable(prev, &kbuf[last], report)) {
+            kbuf[last] = *report;
+            goto transfer;
+        }
+    }
+
+    if (!vusb_wait(kbuf_full)) {
         debug("kbuf: full\n");
+        kbuf_tail = (kbuf_tail + 1) % KBUF_SIZE;
     }
+    kbuf[kbuf_head] = *report;
+    kbuf_head = (kbuf_head + 1) % KBUF_SIZE;
 
+transfer:
     // NOTE: send key strokes of Macro
     usbPoll();
-    vusb_transfer_keyboard();
+    vusb_transfer();
 }
 
-
-typedef struct {
-    uint8_t report_id;
-    report_mouse_t report;
-} __attribute__ ((packed)) vusb_mouse_report_t;
-
 static void send_mouse(report_mouse_t *report)
 {
-    vusb_mouse_report_t r = {
-        .report_id = REPORT_ID_MOUSE,
-        .report = *report
-    };
-    if (usbInterruptIsReady3()) {
-        usbSetInterrupt3((void *)&r, sizeof(vusb_mouse_report_t));
+    mouse_motion_t *m = mbuf_count ? &mbuf[(mbuf_head + mbuf_count - 1) % MBUF_SIZE] : NULL;
+    if (!m || m->buttons != report->buttons) {
+        if (!vusb_wait(mbuf_full)) {
+            debug("mbuf: full\n");
+            mbuf_head = (mbuf_head + 1) % MBUF_SIZE;
+            mbuf_count--;
+        }
+        m = &mbuf[(mbuf_head + mbuf_count++) % MBUF_SIZE];
+        *m = (mouse_motion_t){ .buttons = report->buttons };
     }
+    m->x = add_sat(m->x, report->x);
+    m->y = add_sat(m->y, report->y);
+    m->v = add_sat(m->v, report->v);
+    m->h = add_sat(m->h, report->h);
+    vusb_transfer();
 }
 
-
-typedef struct {
-    uint8_t  report_id;
-    uint16_t usage;
-} __attribute__ ((packed)) report_extra_t;
+static void send_extra(uint8_t report_id, uint16_t usage)
+{
+    if (ebuf_count) {
+        // already on its way
+        report_extra_t *last = &ebuf[(ebuf_head + ebuf_count - 1) % EBUF_SIZE];
+        if (last->report_id == report_id && last->usage == usage) return;
+    }
+    if (!vusb_wait(ebuf_full)) {
+        debug("ebuf: full\n");
+        ebuf_head = (ebuf_head + 1) % EBUF_SIZE;
+        ebuf_count--;
+    }
+    ebuf[(ebuf_head + ebuf_count++) % EBUF_SIZE] = (report_extra_t){
+        .report_id = report_id,
+        .usage = usage
+    };
+    vusb_transfer();
+}
 
 static void send_system(uint16_t data)
 {
@@ -130,13 +265,7 @@ static void send_system(uint16_t data)
     if (data == last_data) return;
     last_data = data;
 
-    report_extra_t report = {
-        .report_id = REPORT_ID_SYSTEM,
-        .usage = data
-    };
-    if (usbInterruptIsReady3()) {
-        usbSetInterrupt3((void *)&report, sizeof(report));
-    }
+    send_extra(REPORT_ID_SYSTEM, data);
 }
 
 static void send_consumer(uint16_t data)
@@ -145,13 +274,7 @@ static void send_consumer(uint16_t data)
     if (data == last_data) return;
     last_data = data;
 
-    report_extra_t report = {
-        .report_id = REPORT_ID_CONSUMER,
-        .usage = data
-    };
-    if (usbInterruptIsReady3()) {
-        usbSetInterrupt3((void *)&report, sizeof(report));
-    }
+    send_extra(REPORT_ID_CONSUMER, data);
 }
 
 
@@ -0,0 +1,83 @@
+#!/bin/sh
+# Turn a compiled leader_sequences[] table into a trie of its keys
+#
+# usage: leader_trie.sh <leader_sequences.bin> <count> <max_length> <name>
+#
+# <leader_sequences.bin> is the raw leader_sequences array, as extracted with
+# objcopy from the keymap objects. Only the keycodes at the start of every
+# entry are read, as little endian 16 bit words; the generated source refuses
+# to build for any other target. The functions stay in the table and the trie
+# refers to them by index. Sequences sharing a prefix share its nodes, the
+# first of identical sequences wins. The C source goes to stdout, a summary
+# to stderr.
+
+if [ $# -ne 4 ]; then
+	echo "Usage: $0 <leader_sequences.bin> <count> <max_length> <name>" >&2
+	exit 1
+fi
+
+COUNT=$(($2))
+LENGTH=$(($3))
+
+od -An -v -tu1 "$1" | awk -v count=$COUNT -v length_max=$LENGTH -v name="$4" '
+{
+	for (i = 1; i <= NF; i++)
+		byte[nbytes++] = $i
+}
+END {
+	if (count == 0 || nbytes % count != 0 || nbytes / count < length_max * 2) {
+		printf "leader_trie: %d bytes is not a table of %d sequences\n", nbytes, count > "/dev/stderr"
+		exit 1
+	}
+	entry = nbytes / count
+	none = 65535
+
+	# node 0 is the root, before the first key
+	nodes = 1
+	child[0] = none
+	sibling[0] = none
+	seq[0] = -1
+	for (s = 0; s < count; s++) {
+		node = 0
+		for (d = 0; d < length_max; d++) {
+			o = s * entry + d * 2
+			kc = byte[o] + 256 * byte[o + 1]
+			if (kc == 0)
+				break
+			last = none
+			for (n = child[node]; n != none && key[n] != kc; n = sibling[n])
+				last = n
+			if (n == none) {
+				n = nodes++
+				key[n] = kc
+				child[n] = none
+				sibling[n] = none
+				seq[n] = -1
+				if (last == none)
+					child[node] = n
+				else
+					sibling[last] = n
+			}
+			node = n
+		}
+		if (node != 0 && seq[node] < 0)
+			seq[node] = s
+	}
+
+	print "/* Generated from the keymap by util/leader_trie.sh, do not edit */"
+	print "#include \"quantum.h\""
+	print ""
+	printf "#if LEADER_SEQUENCE_COUNT != %d || LEADER_MAX_LENGTH != %d\n", count, length_max
+	print "#error \"leader trie was generated for a different table\""
+	print "#endif"
+	print "#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__"
+	print "#error \"leader trie was read as little endian keycodes\""
+	print "#endif"
+	print ""
+	print "const leader_node_t PROGMEM leader_trie[] = {"
+	for (n = 0; n < nodes; n++)
+		printf "  { 0x%04X, 0x%04X, 0x%04X, %d },\n", key[n], child[n], sibling[n], seq[n]
+	print "};"
+
+	printf "Leader trie %s: %d sequences, %d nodes\n", name, count, nodes - 1 > "/dev/stderr"
+}'
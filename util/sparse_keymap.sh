@@ -0,0 +1,97 @@
+#!/bin/sh
+# Re-encode a compiled keymaps[][MATRIX_ROWS][MATRIX_COLS] as a sparse table
+#
+# usage: sparse_keymap.sh <keymaps.bin> <rows> <cols> <name>
+#
+# <keymaps.bin> is the raw keymaps array, as extracted with objcopy from the
+# keymap object. Every row of every layer becomes a bitmap of the positions
+# that are not KC_TRNS, plus the offset of its first keycode in one packed
+# array. The C source goes to stdout, the flash-savings report to stderr.
+
+if [ $# -ne 4 ]; then
+	echo "Usage: $0 <keymaps.bin> <rows> <cols> <name>" >&2
+	exit 1
+fi
+
+ROWS=$(($2))
+COLS=$(($3))
+
+od -An -v -tu1 "$1" | awk -v rows=$ROWS -v cols=$COLS -v name="$4" '
+{
+	for (i = 1; i <= NF; i++)
+		byte[nbytes++] = $i
+}
+END {
+	# little endian, like every target we build for
+	nwords = int(nbytes / 2)
+	for (i = 0; i < nwords; i++)
+		word[i] = byte[2 * i] + 256 * byte[2 * i + 1]
+
+	per_layer = rows * cols
+	if (per_layer == 0 || nwords % per_layer != 0) {
+		printf "sparse_keymap: %d bytes is not a whole number of %dx%d layers\n", nbytes, rows, cols > "/dev/stderr"
+		exit 1
+	}
+	layers = nwords / per_layer
+	row_bytes = cols <= 8 ? 1 : (cols <= 16 ? 2 : 4)
+
+	count = 0
+	for (l = 0; l < layers; l++) {
+		used[l] = 0
+		for (r = 0; r < rows; r++) {
+			offset[l, r] = count
+			bits[l, r] = 0
+			for (c = 0; c < cols; c++) {
+				kc = word[(l * rows + r) * cols + c]
+				if (kc != 1) {
+					bits[l, r] += 2 ^ c
+					packed[count++] = kc
+					used[l]++
+				}
+			}
+		}
+	}
+
+	print "/* Generated from the keymap by util/sparse_keymap.sh, do not edit */"
+	print "#include \"quantum.h\""
+	print ""
+	printf "#if MATRIX_ROWS != %d || MATRIX_COLS != %d\n", rows, cols
+	print "#error \"sparse keymap was generated for a different matrix\""
+	print "#endif"
+	print ""
+	printf "const uint8_t sparse_keymap_layers = %d;\n\n", layers
+
+	print "const matrix_row_t PROGMEM sparse_keymap_bits[][MATRIX_ROWS] = {"
+	for (l = 0; l < layers; l++) {
+		printf "  {"
+		for (r = 0; r < rows; r++)
+			printf "%s0x%X", (r ? ", " : " "), bits[l, r]
+		print " },"
+	}
+	print "};"
+	print ""
+
+	print "const uint16_t PROGMEM sparse_keymap_offsets[][MATRIX_ROWS] = {"
+	for (l = 0; l < layers; l++) {
+		printf "  {"
+		for (r = 0; r < rows; r++)
+			printf "%s%d", (r ? ", " : " "), offset[l, r]
+		print " },"
+	}
+	print "};"
+	print ""
+
+	print "const uint16_t PROGMEM sparse_keymap_keycodes[] = {"
+	for (i = 0; i < count; i++)
+		printf "%s0x%04X,%s", (i % 8 ? " " : "  "), packed[i], (i % 8 == 7 || i == count - 1 ? "\n" : "")
+	if (count == 0)
+		print "  0"
+	print "};"
+
+	dense = nwords * 2
+	sparse = count * 2 + layers * rows * (2 + row_bytes)
+	printf "Sparse keymap %s: %d layers\n", name, layers > "/dev/stderr"
+	for (l = 0; l < layers; l++)
+		printf "  layer %2d: %3d of %d keys set\n", l, used[l], per_layer > "/dev/stderr"
+	printf "  dense %d bytes, sparse %d bytes, saved %d bytes\n", dense, sparse, dense - sparse > "/dev/stderr"
+}'